@@ -2,7 +2,46 @@
 #define NDI_MODULE_H
 
 #include "audioQueue.h"
+#include "sourceRegistry.h"
 
-void NDIAudioReceive(std::vector<audioQueue<float>>& queueList, int PA_SAMPLE_RATE, int PA_OUTPUT_CHANNELS);
+/**
+ * @brief How NDI audio reaches the output : queued by capture workers, or pulled by the output callback through FrameSync.
+ */
+enum class NDIInputMode
+{
+	queue,
+	frameSync
+};
+
+/**
+ * @brief Receive engine settings : how the capture workers are spread over the selected sources.
+ */
+struct NDIReceiveOptions
+{
+	std::size_t workerCount = 0;	 // Capture threads, 0 gives every source its own blocking worker
+	bool		pinWorkers	= false; // Pin worker n to core firstCore + n, wrapping around the core count
+	std::size_t firstCore	= 0;
+};
+
+/**
+ * @brief Number of heap allocations made by the capture workers since start, stops growing in steady state.
+ * 
+ * Counts the scratch buffers and what the queues allocate while being fed : ring growth, converters and work buffers.
+ */
+std::uint64_t NDIAllocationCount();
+
+void NDIAudioReceive(sourceRegistry<mixQueue>& registry, int PA_SAMPLE_RATE, int PA_OUTPUT_CHANNELS, const NDIReceiveOptions& options = {});
+
+/**
+ * @brief FrameSync input : select sources and publish them for NDIFrameSyncMix, returns once they are connected.
+ * 
+ * NDIFrameSyncMix is called from the output callback and accumulates exactly frames frames of every source into out,
+ * the SDK corrects the time base so no queue or drift control is involved. Returns the number of sources.
+ * NDIFrameSyncClose must only be called once the output stream is stopped.
+ */
+void		NDIFrameSyncReceive(int PA_SAMPLE_RATE, int PA_OUTPUT_CHANNELS);
+std::size_t NDIFrameSyncMix(float* out, std::size_t frames);
+std::size_t NDIFrameSyncSourceCount();
+void		NDIFrameSyncClose();
 
 #endif//NDI_MODUEL_H
\ No newline at end of file
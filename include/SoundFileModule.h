@@ -1,9 +1,180 @@
 #ifndef SOUNDFILE_MODULE_H
 #define SOUNDFILE_MODULE_H
 
+#include <atomic>
+#include <filesystem>
+#include <thread>
 #include "sndfile.hh"
 #include "audioQueue.h"
+#include "sourceRegistry.h"
 
-void sndfileReceive(std::vector<audioQueue<float>>& queueList, int PA_SAMPLE_RATE, int PA_OUTPUT_CHANNELS);
+/**
+ * @brief Play region of a file source, in file frames.
+ */
+struct fileCue
+{
+	std::size_t in	 = 0;		// First frame played
+	std::size_t out	 = 0;		// Frame after the last one played, 0 plays to the end of the file
+	bool		loop = false;	// Jump back to in when out is reached
+};
+
+/**
+ * @brief File streamed from disk into a bounded audioQueue by its own I/O thread.
+ *
+ * The file is read in chunks of a quarter of the read ahead, and the queue is only refilled while it
+ * holds less than the read ahead, so memory use depends on the latency target, not on the file length.
+ * The queue joins the registry once the first read ahead is buffered and leaves it with the source.
+ * A derived reader implements pushFrames and must call stop in its destructor, before its own members go.
+ *
+ * Looping, cue points and seeks are all handled by the I/O thread at the chunk level : a loop pushes the
+ * frames after the cue in straight behind the last frames before the cue out, so the queue never sees a gap,
+ * and a seek prefetches the new region while the old one keeps playing, then flushes the queue and switches.
+ * The I/O thread runs until the source is destroyed, so a seek, a cue change or turning looping on
+ * after the end of the file was reached, while its last read ahead is still playing, starts reading again.
+ */
+class fileSource
+{
+	private :
+		static constexpr std::size_t		noSeek = static_cast<std::size_t>(-1);
+
+		std::atomic<std::size_t>			cueIn;
+		std::atomic<std::size_t>			cueOut;
+		std::atomic<bool>					looping;
+		std::atomic<std::size_t>			seekTarget;
+		std::atomic<bool>					cueMoved;
+
+				void		readLoop		(std::stop_token stop);
+				bool		readChunk		();
+				void		seekTo			(std::size_t frame);
+				std::size_t	regionEnd		() const;
+	protected :
+		sourceRegistry<mixQueue>&	registry;
+		mixQueue*					queue;
+		std::uint32_t						outputRate;
+		std::uint8_t						outputChannels;
+		std::size_t							chunkFrames;
+		std::size_t							readAheadFrames;
+		std::size_t							position;
+		std::size_t							length;
+		std::atomic<bool>					endOfFile;
+		std::jthread						reader;
+
+							fileSource		(sourceRegistry<mixQueue>& registry,
+											 std::uint32_t						sampleRate,
+											 std::uint8_t						channels,
+											 std::size_t						readAheadFrames,
+											 const fileCue&						cue);
+				void		start			(std::size_t lengthFrames, std::uint32_t fileRate);
+				void		stop			();
+		virtual std::size_t	pushFrames		(std::size_t first, std::size_t frames) = 0;
+		virtual void		prefetch		(std::size_t, std::size_t) {}
+	public :
+							fileSource		(const fileSource& other) = delete;
+		virtual				~fileSource		();
+
+				bool		isOpen			() const { return queue != nullptr; }
+				void		seek			(std::size_t frame) { seekTarget.store(frame); }
+				void		setLoop			(bool loop)			{ looping.store(loop); }
+				void		setCue			(std::size_t in, std::size_t out);
+				bool		finished		() const { return endOfFile.load() && (!queue || queue->size() == 0); }
+				bool		ready			(std::size_t frames) const { return endOfFile.load() || (queue && queue->size() / outputChannels >= frames); }
+};
+
+/**
+ * @brief Any format libsndfile decodes, read with readf.
+ */
+class sndfileSource : public fileSource
+{
+	private :
+		SndfileHandle		file;
+		std::vector<float>	chunk;
+		sf_count_t			filePosition;
+		std::size_t			stagedFirst;
+		std::size_t			stagedFrames;
+
+		std::size_t	pushFrames		(std::size_t first, std::size_t frames) override;
+		void		prefetch		(std::size_t first, std::size_t frames) override;
+	public :
+					sndfileSource	(const std::filesystem::path&		path,
+									 sourceRegistry<mixQueue>& registry,
+									 std::uint32_t						sampleRate,
+									 std::uint8_t						channels,
+									 std::size_t						readAheadFrames,
+									 const fileCue&						cue = {});
+					~sndfileSource	() override { stop(); }
+};
+
+/**
+ * @brief Read only memory mapping of a whole file, with sequential access and prefetch hints.
+ */
+class mappedFile
+{
+	private :
+#ifdef _WIN32
+		void*			fileHandle;
+		void*			mappingHandle;
+#else
+		int				descriptor;
+#endif
+		const std::byte*	view;
+		std::size_t			viewSize;
+	public :
+		explicit			mappedFile		(const std::filesystem::path& path);
+							mappedFile		(const mappedFile& other) = delete;
+							~mappedFile		();
+
+				void		prefetch		(std::size_t offset, std::size_t bytes) const;
+		const std::byte*	data			() const { return view; }
+				std::size_t	size			() const { return viewSize; }
+};
+
+/**
+ * @brief Uncompressed WAV, 16 bit PCM or 32 bit float, fed to the queue straight from a memory mapping.
+ *
+ * Float data that is suitably aligned, and 16 bit PCM into a 16 bit mixQueue, are pushed from the mapping without an intermediate
+ * buffer, 16 bit PCM into any other queue is widened to float chunk by chunk. The region after the play cursor is prefetched one
+ * read ahead in advance.
+ */
+class mappedWavSource : public fileSource
+{
+	private :
+		mappedFile			file;
+		const std::byte*	samples;
+		std::uint8_t		fileChannels;
+		std::uint32_t		fileRate;
+		bool				isFloat;
+		std::vector<float>	chunk;
+
+				bool	parseHeader		();
+		std::size_t		pushFrames		(std::size_t first, std::size_t frames) override;
+		void			prefetch		(std::size_t first, std::size_t frames) override;
+	public :
+						mappedWavSource	(const std::filesystem::path&		path,
+										 sourceRegistry<mixQueue>& registry,
+										 std::uint32_t						sampleRate,
+										 std::uint8_t						channels,
+										 std::size_t						readAheadFrames,
+										 const fileCue&						cue = {});
+						~mappedWavSource() override { stop(); }
+};
+
+/**
+ * @brief Stream every file of pathList into registry until all of them are played out, asks for the paths on the console if it is empty.
+ */
+void sndfileReceive(sourceRegistry<mixQueue>& registry, int PA_SAMPLE_RATE, int PA_OUTPUT_CHANNELS, std::vector<std::filesystem::path> pathList = {});
+
+/**
+ * @brief Mix sound files into output as fast as they can be decoded, returns the number of frames written.
+ *
+ * The inputs are streamed and mixed exactly like in real time playback, but a pull loop takes the place of
+ * the output callback : each block waits until every input has it buffered, so the result does not depend
+ * on the machine speed. The output format follows the extension, .flac gives 24 bit FLAC, anything else float WAV.
+ * maxFrames bounds the length, it is required to render looping inputs, 0 renders until every input is done.
+ */
+std::size_t sndfileRender(const std::vector<std::filesystem::path>& inputs,
+						  const std::filesystem::path&				output,
+						  int										PA_SAMPLE_RATE,
+						  int										PA_OUTPUT_CHANNELS,
+						  std::size_t								maxFrames = 0);
 
 #endif
\ No newline at end of file
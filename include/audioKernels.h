@@ -0,0 +1,770 @@
+#ifndef AUDIO_KERNELS_H
+#define AUDIO_KERNELS_H
+
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX2__)
+#define AUDIO_KERNELS_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AUDIO_KERNELS_SSE
+#endif
+#if defined(AUDIO_KERNELS_AVX2) || defined(AUDIO_KERNELS_SSE)
+#include <immintrin.h>
+#endif
+
+#pragma region Sample types
+/**
+ * @brief Packed little endian 24 bit sample, as stored in 24 bit WAV files. Three bytes, no alignment.
+ */
+struct int24
+{
+    std::uint8_t bytes[3];
+
+                  int24     ()                          = default;
+    constexpr     int24     (const std::int32_t value)  noexcept : bytes{ static_cast<std::uint8_t>(value), static_cast<std::uint8_t>(value >> 8), static_cast<std::uint8_t>(value >> 16) } {}
+    constexpr operator std::int32_t () const            noexcept { return static_cast<std::int32_t>(static_cast<std::uint32_t>(bytes[0]) << 8 | static_cast<std::uint32_t>(bytes[1]) << 16 | static_cast<std::uint32_t>(bytes[2]) << 24) >> 8; }
+};
+static_assert(sizeof(int24) == 3);
+
+/**
+ * @brief Per format constants : the type arithmetic is done in, the value of full scale and the integer range.
+ *
+ * 32 bit integers and doubles accumulate in double, float cannot hold their resolution.
+ */
+template<typename T> struct sampleTraits;
+template<> struct sampleTraits<short>        { using accumulator = float;  static constexpr double scale = 32768.0;      static constexpr long long minimum = -32768;      static constexpr long long maximum = 32767;      };
+template<> struct sampleTraits<int24>        { using accumulator = float;  static constexpr double scale = 8388608.0;    static constexpr long long minimum = -8388608;    static constexpr long long maximum = 8388607;    };
+template<> struct sampleTraits<std::int32_t> { using accumulator = double; static constexpr double scale = 2147483648.0; static constexpr long long minimum = -2147483648LL; static constexpr long long maximum = 2147483647LL; };
+template<> struct sampleTraits<float>        { using accumulator = float;  static constexpr double scale = 1.0; };
+template<> struct sampleTraits<double>       { using accumulator = double; static constexpr double scale = 1.0; };
+
+template<typename T>
+using sampleAccumulator = typename sampleTraits<T>::accumulator;
+#pragma endregion
+
+#pragma region Sample conversion
+/**
+ * @brief Convert an accumulator back to a sample type, rounding and saturating integer formats.
+ */
+template<typename T, typename A>
+inline T sampleCast(const A value) noexcept
+{
+    if constexpr (std::floating_point<T>)
+        return static_cast<T>(value);
+    else
+        return static_cast<T>(std::clamp<long long>(std::llrint(value), sampleTraits<T>::minimum, sampleTraits<T>::maximum));
+}
+
+/**
+ * @brief 16 bit PCM to float in [-1, 1), the scaling of libsamplerate's src_short_to_float_array.
+ */
+inline void shortToFloat(const short*       in,
+                               float*       out,
+                         const std::size_t  count) noexcept
+{
+    constexpr float scale = 1.0f / 32768.0f;
+    std::size_t i = 0;
+#if defined(AUDIO_KERNELS_AVX2)
+    const auto scale8 = _mm256_set1_ps(scale);
+    for (; i + 8 <= count; i += 8)
+    {
+        const auto wide = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(wide), scale8));
+    }
+#endif
+#if defined(AUDIO_KERNELS_SSE)
+    const auto scale4 = _mm_set1_ps(scale);
+    for (; i + 8 <= count; i += 8)
+    {
+        // Sign extension by unpacking each sample into the high half of a 32 bit lane, then shifting it down.
+        const auto packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        const auto lo     = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+        const auto hi     = _mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16);
+        _mm_storeu_ps(out + i    , _mm_mul_ps(_mm_cvtepi32_ps(lo), scale4));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale4));
+    }
+#endif
+    for (; i < count; i++)
+        out[i] = in[i] * scale;
+}
+
+/**
+ * @brief Float in [-1, 1) to 16 bit PCM, rounded to nearest and saturated, as src_float_to_short_array.
+ */
+inline void floatToShort(const float*       in,
+                               short*       out,
+                         const std::size_t  count) noexcept
+{
+    std::size_t i = 0;
+#if defined(AUDIO_KERNELS_SSE)
+    // Clamping before the conversion keeps large values from turning into the integer indefinite value.
+    const auto scale4 = _mm_set1_ps(32768.0f);
+    const auto low4   = _mm_set1_ps(-32768.0f);
+    const auto high4  = _mm_set1_ps( 32767.0f);
+    for (; i + 8 <= count; i += 8)
+    {
+        const auto lo = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i    ), scale4), low4), high4));
+        const auto hi = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale4), low4), high4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(lo, hi));
+    }
+#endif
+    for (; i < count; i++)
+        out[i] = sampleCast<short>(in[i] * 32768.0f);
+}
+
+/**
+ * @brief Any sample format to float in [-1, 1), the conversion is chosen at compile time.
+ */
+template<typename T>
+inline void samplesToFloat(const T*          in,
+                                 float*      out,
+                           const std::size_t count) noexcept
+{
+    if constexpr (std::same_as<T, float>)
+        std::memcpy(out, in, count * sizeof(float));
+    else if constexpr (std::same_as<T, short>)
+        shortToFloat(in, out, count);
+    else if constexpr (std::same_as<T, double>)
+    {
+        std::size_t i = 0;
+#if defined(AUDIO_KERNELS_SSE)
+        for (; i + 4 <= count; i += 4)
+            _mm_storeu_ps(out + i, _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(in + i)), _mm_cvtpd_ps(_mm_loadu_pd(in + i + 2))));
+#endif
+        for (; i < count; i++)
+            out[i] = static_cast<float>(in[i]);
+    }
+    else if constexpr (std::same_as<T, std::int32_t>)
+    {
+        std::size_t i = 0;
+#if defined(AUDIO_KERNELS_SSE)
+        const auto scale4 = _mm_set1_ps(static_cast<float>(1.0 / sampleTraits<T>::scale));
+        for (; i + 4 <= count; i += 4)
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i))), scale4));
+#endif
+        for (; i < count; i++)
+            out[i] = static_cast<float>(in[i] / sampleTraits<T>::scale);
+    }
+    else
+    {
+        // Packed 24 bit has no vector load, the byte gather costs more than the conversion.
+        constexpr auto scale = static_cast<float>(1.0 / sampleTraits<T>::scale);
+        for (std::size_t i = 0; i < count; i++)
+            out[i] = static_cast<float>(static_cast<std::int32_t>(in[i])) * scale;
+    }
+}
+
+/**
+ * @brief Float in [-1, 1) to any sample format, integers rounded to nearest and saturated, chosen at compile time.
+ */
+template<typename T>
+inline void samplesFromFloat(const float*      in,
+                                   T*          out,
+                             const std::size_t count) noexcept
+{
+    if constexpr (std::same_as<T, float>)
+        std::memcpy(out, in, count * sizeof(float));
+    else if constexpr (std::same_as<T, short>)
+        floatToShort(in, out, count);
+    else if constexpr (std::same_as<T, double>)
+    {
+        std::size_t i = 0;
+#if defined(AUDIO_KERNELS_SSE)
+        for (; i + 4 <= count; i += 4)
+        {
+            const auto value = _mm_loadu_ps(in + i);
+            _mm_storeu_pd(out + i    , _mm_cvtps_pd(value));
+            _mm_storeu_pd(out + i + 2, _mm_cvtps_pd(_mm_movehl_ps(value, value)));
+        }
+#endif
+        for (; i < count; i++)
+            out[i] = in[i];
+    }
+    else
+    {
+        // Scaled in double so full scale 32 bit values are not rounded past the clamp.
+        for (std::size_t i = 0; i < count; i++)
+            out[i] = sampleCast<T>(static_cast<double>(in[i]) * sampleTraits<T>::scale);
+    }
+}
+#pragma endregion
+
+#pragma region Mixing kernels
+/**
+ * @brief Accumulate a block of samples into an output buffer : out += in * gain.
+ */
+template<typename T>
+inline void mixScaled(      T*          out,
+                      const T*          in,
+                      const std::size_t count,
+                      const float       gain) noexcept
+{
+    using A = sampleAccumulator<T>;
+    for (std::size_t i = 0; i < count; i++)
+        out[i] = sampleCast<T>(static_cast<A>(out[i]) + static_cast<A>(in[i]) * gain);
+}
+
+inline void mixScaled(      double*     out,
+                      const double*     in,
+                      const std::size_t count,
+                      const float       gain) noexcept
+{
+    std::size_t i = 0;
+#if defined(AUDIO_KERNELS_AVX2)
+    const auto gain4 = _mm256_set1_pd(gain);
+    for (; i + 4 <= count; i += 4)
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(out + i), _mm256_mul_pd(_mm256_loadu_pd(in + i), gain4)));
+#endif
+#if defined(AUDIO_KERNELS_SSE)
+    const auto gain2 = _mm_set1_pd(gain);
+    for (; i + 2 <= count; i += 2)
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(out + i), _mm_mul_pd(_mm_loadu_pd(in + i), gain2)));
+#endif
+    for (; i < count; i++)
+        out[i] += in[i] * gain;
+}
+
+inline void mixScaled(      float*      out,
+                      const float*      in,
+                      const std::size_t count,
+                      const float       gain) noexcept
+{
+    std::size_t i = 0;
+#if defined(AUDIO_KERNELS_AVX2)
+    const auto gain8 = _mm256_set1_ps(gain);
+    for (; i + 16 <= count; i += 16)
+    {
+        _mm256_storeu_ps(out + i    , _mm256_add_ps(_mm256_loadu_ps(out + i    ), _mm256_mul_ps(_mm256_loadu_ps(in + i    ), gain8)));
+        _mm256_storeu_ps(out + i + 8, _mm256_add_ps(_mm256_loadu_ps(out + i + 8), _mm256_mul_ps(_mm256_loadu_ps(in + i + 8), gain8)));
+    }
+#endif
+#if defined(AUDIO_KERNELS_SSE)
+    const auto gain4 = _mm_set1_ps(gain);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), gain4)));
+#endif
+    for (; i < count; i++)
+        out[i] += in[i] * gain;
+}
+
+/**
+ * @brief Saturating 16 bit accumulation : unity gain is a saturating integer add, any other gain goes through float.
+ */
+inline void mixScaled(      short*      out,
+                      const short*      in,
+                      const std::size_t count,
+                      const float       gain) noexcept
+{
+    std::size_t i = 0;
+#if defined(AUDIO_KERNELS_AVX2)
+    if (gain == 1.0f)
+        for (; i + 16 <= count; i += 16)
+        {
+            const auto sum = _mm256_adds_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(out + i)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), sum);
+        }
+#endif
+#if defined(AUDIO_KERNELS_SSE)
+    if (gain == 1.0f)
+        for (; i + 8 <= count; i += 8)
+        {
+            const auto sum = _mm_adds_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(out + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), sum);
+        }
+    else
+    {
+        const auto gain4 = _mm_set1_ps(gain);
+        const auto low4  = _mm_set1_ps(-32768.0f);
+        const auto high4 = _mm_set1_ps( 32767.0f);
+        for (; i + 8 <= count; i += 8)
+        {
+            const auto src = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in  + i));
+            const auto dst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out + i));
+            const auto lo  = _mm_add_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(dst, dst), 16)),
+                                        _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(src, src), 16)), gain4));
+            const auto hi  = _mm_add_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(dst, dst), 16)),
+                                        _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(src, src), 16)), gain4));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(_mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(lo, low4), high4)),
+                                                                               _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(hi, low4), high4))));
+        }
+    }
+#endif
+    for (; i < count; i++)
+        out[i] = sampleCast<short>(static_cast<float>(out[i]) + static_cast<float>(in[i]) * gain);
+}
+
+/**
+ * @brief Accumulate interleaved samples with a per channel gain that moves linearly by steps[c] every frame.
+ *
+ * phase is the channel of in[0], so a block split anywhere inside a frame can be mixed in two calls.
+ * gains is advanced in place and holds the gain of the next frame on return.
+ */
+template<typename T>
+inline void mixRamp(      T*           out,
+                    const T*           in,
+                    const std::size_t  count,
+                    const std::uint8_t channels,
+                          std::uint8_t phase,
+                          float*       gains,
+                    const float*       steps) noexcept
+{
+    using A = sampleAccumulator<T>;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        out[i] = sampleCast<T>(static_cast<A>(out[i]) + static_cast<A>(in[i]) * gains[phase]);
+        gains[phase] += steps[phase];
+        if (++phase == channels) phase = 0;
+    }
+}
+
+inline void mixRamp(      float*       out,
+                    const float*       in,
+                    const std::size_t  count,
+                    const std::uint8_t channels,
+                          std::uint8_t phase,
+                          float*       gains,
+                    const float*       steps) noexcept
+{
+    std::size_t i = 0;
+#if defined(AUDIO_KERNELS_SSE)
+    // Mono and frame aligned stereo keep a whole vector of gains and add a whole vector of steps per iteration.
+    if ((channels == 1 || channels == 2) && phase == 0)
+    {
+        const auto framesPerVector = 4 / channels;
+        auto gain4 = channels == 1 ? _mm_setr_ps(gains[0], gains[0] + steps[0], gains[0] + 2 * steps[0], gains[0] + 3 * steps[0])
+                                   : _mm_setr_ps(gains[0], gains[1], gains[0] + steps[0], gains[1] + steps[1]);
+        const auto step4 = channels == 1 ? _mm_set1_ps(4 * steps[0])
+                                         : _mm_setr_ps(2 * steps[0], 2 * steps[1], 2 * steps[0], 2 * steps[1]);
+        for (; i + 4 <= count; i += 4)
+        {
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), gain4)));
+            gain4 = _mm_add_ps(gain4, step4);
+        }
+        // Resynchronise the scalar gains from the frame count so the tail and the next span continue the ramp.
+        const auto framesDone = static_cast<float>(i / 4 * framesPerVector);
+        for (std::uint8_t c = 0; c < channels; c++)
+            gains[c] += steps[c] * framesDone;
+    }
+#endif
+    for (; i < count; i++)
+    {
+        out[i] += in[i] * gains[phase];
+        gains[phase] += steps[phase];
+        if (++phase == channels) phase = 0;
+    }
+}
+
+/**
+ * @brief Accumulate samples of any format into a float bus, converted and scaled in the same pass : out += in / full scale * gain.
+ *
+ * Each format takes its own branch at compile time : short and int32 widen or convert in vector registers, double narrows after
+ * the gain is applied. int24 has its own scalar loop, every other format finishes what the vectors left in the generic scalar tail.
+ */
+template<typename T>
+inline void mixToFloat(      float*      out,
+                       const T*          in,
+                       const std::size_t count,
+                       const float       gain) noexcept
+{
+    std::size_t i = 0;
+    if constexpr (std::same_as<T, short>)
+    {
+#if defined(AUDIO_KERNELS_AVX2)
+        const auto gain8 = _mm256_set1_ps(gain / 32768.0f);
+        for (; i + 8 <= count; i += 8)
+        {
+            const auto wide = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+            _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(_mm256_cvtepi32_ps(wide), gain8)));
+        }
+#endif
+#if defined(AUDIO_KERNELS_SSE)
+        const auto gain4 = _mm_set1_ps(gain / 32768.0f);
+        for (; i + 8 <= count; i += 8)
+        {
+            const auto packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            const auto lo     = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16));
+            const auto hi     = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16));
+            _mm_storeu_ps(out + i    , _mm_add_ps(_mm_loadu_ps(out + i    ), _mm_mul_ps(lo, gain4)));
+            _mm_storeu_ps(out + i + 4, _mm_add_ps(_mm_loadu_ps(out + i + 4), _mm_mul_ps(hi, gain4)));
+        }
+#endif
+    }
+    else if constexpr (std::same_as<T, std::int32_t>)
+    {
+        // The bus is float, so rounding the integer to 24 bits of mantissa before scaling loses nothing the output keeps.
+#if defined(AUDIO_KERNELS_AVX2)
+        const auto gain8 = _mm256_set1_ps(static_cast<float>(gain / 2147483648.0));
+        for (; i + 8 <= count; i += 8)
+        {
+            const auto value = _mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)));
+            _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(value, gain8)));
+        }
+#endif
+#if defined(AUDIO_KERNELS_SSE)
+        const auto gain4 = _mm_set1_ps(static_cast<float>(gain / 2147483648.0));
+        for (; i + 4 <= count; i += 4)
+        {
+            const auto value = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(value, gain4)));
+        }
+#endif
+    }
+    else if constexpr (std::same_as<T, double>)
+    {
+#if defined(AUDIO_KERNELS_AVX2)
+        const auto gain4d = _mm256_set1_pd(gain);
+        for (; i + 4 <= count; i += 4)
+        {
+            const auto value = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_loadu_pd(in + i), gain4d));
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), value));
+        }
+#endif
+#if defined(AUDIO_KERNELS_SSE)
+        const auto gain2d = _mm_set1_pd(gain);
+        for (; i + 4 <= count; i += 4)
+        {
+            const auto lo = _mm_cvtpd_ps(_mm_mul_pd(_mm_loadu_pd(in + i    ), gain2d));
+            const auto hi = _mm_cvtpd_ps(_mm_mul_pd(_mm_loadu_pd(in + i + 2), gain2d));
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_movelh_ps(lo, hi)));
+        }
+#endif
+    }
+    if constexpr (std::same_as<T, int24>)
+    {
+        // Three bytes per sample do not fill a vector register evenly, the whole block is unpacked in scalar code.
+        const auto scaled = static_cast<float>(gain / sampleTraits<int24>::scale);
+        for (; i < count; i++)
+            out[i] += static_cast<float>(static_cast<std::int32_t>(in[i])) * scaled;
+    }
+    else
+    {
+        using A = sampleAccumulator<T>;
+        const auto scaled = static_cast<A>(gain / sampleTraits<T>::scale);
+        for (; i < count; i++)
+            out[i] += static_cast<float>(static_cast<A>(in[i]) * scaled);
+    }
+}
+
+/**
+ * @brief mixRamp from any sample format into a float bus, the full scale of the format is folded into the gains.
+ */
+template<typename T>
+inline void mixRampToFloat(      float*       out,
+                           const T*           in,
+                           const std::size_t  count,
+                           const std::uint8_t channels,
+                                 std::uint8_t phase,
+                                 float*       gains,
+                           const float*       steps) noexcept
+{
+    constexpr auto scale = static_cast<float>(1.0 / sampleTraits<T>::scale);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        out[i] += static_cast<float>(in[i]) * scale * gains[phase];
+        gains[phase] += steps[phase];
+        if (++phase == channels) phase = 0;
+    }
+}
+
+/**
+ * @brief Accumulate planar channels into an interleaved output : out[f * channels + c] += in[c * stride + f] * gain.
+ */
+inline void mixPlanar(      float*       out,
+                      const float*       in,
+                      const std::size_t  frames,
+                      const std::uint8_t channels,
+                      const std::size_t  stride,
+                      const float        gain) noexcept
+{
+    std::size_t f = 0;
+#if defined(AUDIO_KERNELS_SSE)
+    // Stereo interleaves four frames of both planes per iteration.
+    if (channels == 2)
+    {
+        const auto gain4 = _mm_set1_ps(gain);
+        for (; f + 4 <= frames; f += 4)
+        {
+            const auto left  = _mm_mul_ps(_mm_loadu_ps(in + f         ), gain4);
+            const auto right = _mm_mul_ps(_mm_loadu_ps(in + stride + f), gain4);
+            _mm_storeu_ps(out + 2 * f    , _mm_add_ps(_mm_loadu_ps(out + 2 * f    ), _mm_unpacklo_ps(left, right)));
+            _mm_storeu_ps(out + 2 * f + 4, _mm_add_ps(_mm_loadu_ps(out + 2 * f + 4), _mm_unpackhi_ps(left, right)));
+        }
+    }
+#endif
+    for (; f < frames; f++)
+        for (std::uint8_t c = 0; c < channels; c++)
+            out[f * channels + c] += in[c * stride + f] * gain;
+}
+#pragma endregion
+
+#pragma region Channel conversion kernels
+/**
+ * @brief Mono to stereo, each output channel is the mono sample scaled by its own gain.
+ */
+inline void monoToStereo(const float*       in,
+                               float*       out,
+                         const std::size_t  frames,
+                         const float        leftGain,
+                         const float        rightGain) noexcept
+{
+    std::size_t i = 0;
+#if defined(AUDIO_KERNELS_AVX2)
+    const auto gain8 = _mm256_setr_ps(leftGain, rightGain, leftGain, rightGain, leftGain, rightGain, leftGain, rightGain);
+    for (; i + 8 <= frames; i += 8)
+    {
+        const auto mono = _mm256_loadu_ps(in + i);
+        const auto lo   = _mm256_unpacklo_ps(mono, mono); // a0 a0 a1 a1 | a4 a4 a5 a5
+        const auto hi   = _mm256_unpackhi_ps(mono, mono); // a2 a2 a3 a3 | a6 a6 a7 a7
+        _mm256_storeu_ps(out + 2 * i    , _mm256_mul_ps(_mm256_permute2f128_ps(lo, hi, 0x20), gain8));
+        _mm256_storeu_ps(out + 2 * i + 8, _mm256_mul_ps(_mm256_permute2f128_ps(lo, hi, 0x31), gain8));
+    }
+#endif
+#if defined(AUDIO_KERNELS_SSE)
+    const auto gain4 = _mm_setr_ps(leftGain, rightGain, leftGain, rightGain);
+    for (; i + 4 <= frames; i += 4)
+    {
+        const auto mono = _mm_loadu_ps(in + i);
+        _mm_storeu_ps(out + 2 * i    , _mm_mul_ps(_mm_unpacklo_ps(mono, mono), gain4));
+        _mm_storeu_ps(out + 2 * i + 4, _mm_mul_ps(_mm_unpackhi_ps(mono, mono), gain4));
+    }
+#endif
+    for (; i < frames; i++)
+    {
+        out[2 * i    ] = in[i] * leftGain;
+        out[2 * i + 1] = in[i] * rightGain;
+    }
+}
+
+/**
+ * @brief Stereo to mono as a weighted sum of both channels.
+ */
+inline void stereoToMono(const float*       in,
+                               float*       out,
+                         const std::size_t  frames,
+                         const float        leftGain,
+                         const float        rightGain) noexcept
+{
+    std::size_t i = 0;
+#if defined(AUDIO_KERNELS_AVX2)
+    const auto left8  = _mm256_set1_ps(leftGain);
+    const auto right8 = _mm256_set1_ps(rightGain);
+    for (; i + 8 <= frames; i += 8)
+    {
+        const auto a     = _mm256_loadu_ps(in + 2 * i);
+        const auto b     = _mm256_loadu_ps(in + 2 * i + 8);
+        // Per 128 bit lane deinterleave gives L0 L1 L4 L5 | L2 L3 L6 L7, fixed by one cross lane permute.
+        const auto left  = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const auto right = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        const auto mixed = _mm256_add_ps(_mm256_mul_ps(left, left8), _mm256_mul_ps(right, right8));
+        _mm256_storeu_ps(out + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(mixed), _MM_SHUFFLE(3, 1, 2, 0))));
+    }
+#endif
+#if defined(AUDIO_KERNELS_SSE)
+    const auto left4  = _mm_set1_ps(leftGain);
+    const auto right4 = _mm_set1_ps(rightGain);
+    for (; i + 4 <= frames; i += 4)
+    {
+        const auto a     = _mm_loadu_ps(in + 2 * i);
+        const auto b     = _mm_loadu_ps(in + 2 * i + 4);
+        const auto left  = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const auto right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(left, left4), _mm_mul_ps(right, right4)));
+    }
+#endif
+    for (; i < frames; i++)
+        out[i] = in[2 * i] * leftGain + in[2 * i + 1] * rightGain;
+}
+
+/**
+ * @brief 5.1 or 7.1 to stereo, one frame per iteration with both output rows evaluated side by side.
+ *
+ * Only 6 or 8 input channels are accepted, rows are padded to 8 coefficients.
+ */
+inline void surroundToStereo(const float*       in,
+                                   float*       out,
+                             const std::size_t  frames,
+                             const std::uint8_t inputChannels,
+                             const float*       leftRow,
+                             const float*       rightRow) noexcept
+{
+    std::size_t i = 0;
+#if defined(AUDIO_KERNELS_SSE)
+    const auto leftLo  = _mm_loadu_ps(leftRow);
+    const auto leftHi  = _mm_loadu_ps(leftRow  + 4);
+    const auto rightLo = _mm_loadu_ps(rightRow);
+    const auto rightHi = _mm_loadu_ps(rightRow + 4);
+    for (; i < frames; i++)
+    {
+        const auto* frame = in + i * inputChannels;
+        const auto  lo    = _mm_loadu_ps(frame);
+        // Never read past the frame : 5.1 only loads its last two samples.
+        const auto  hi    = inputChannels == 8 ? _mm_loadu_ps(frame + 4)
+                                               : _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(frame + 4)));
+        const auto  left  = _mm_add_ps(_mm_mul_ps(lo, leftLo ), _mm_mul_ps(hi, leftHi ));
+        const auto  right = _mm_add_ps(_mm_mul_ps(lo, rightLo), _mm_mul_ps(hi, rightHi));
+        // l0+l2 r0+r2 l1+l3 r1+r3, then fold the upper half to get L R in the low half.
+        const auto  pair  = _mm_add_ps(_mm_unpacklo_ps(left, right), _mm_unpackhi_ps(left, right));
+        _mm_storel_pi(reinterpret_cast<__m64*>(out + 2 * i), _mm_add_ps(pair, _mm_movehl_ps(pair, pair)));
+    }
+#endif
+    for (; i < frames; i++)
+    {
+        const auto* frame = in + i * inputChannels;
+        float left = 0, right = 0;
+        for (std::uint8_t c = 0; c < inputChannels; c++)
+        {
+            left  += frame[c] * leftRow [c];
+            right += frame[c] * rightRow[c];
+        }
+        out[2 * i    ] = left;
+        out[2 * i + 1] = right;
+    }
+}
+#pragma endregion
+
+/**
+ * @brief Precomputed channel mixing matrix from an interleaved input layout to an interleaved output layout.
+ *
+ * Coefficients are stored row major, one row of inputChannels gains per output channel.
+ * Surround layouts follow the WAVE order : L R C LFE Ls Rs (Lb Rb).
+ */
+class channelMatrix
+{
+    private :
+        enum class matrixKind { identity, monoToStereo, stereoToMono, surroundToStereo, generic };
+
+                        matrixKind  kind;
+                      std::uint8_t  inputNum;
+                      std::uint8_t  outputNum;
+                std::vector<float>  coefficients;
+
+    public :
+                                    channelMatrix       ()                                  : kind(matrixKind::identity), inputNum(0), outputNum(0) {}
+                                    channelMatrix       (const std::uint8_t inputChannels,
+                                                         const std::uint8_t outputChannels);
+
+        inline        std::uint8_t  inputChannels       () const noexcept                   { return inputNum; }
+        inline        std::uint8_t  outputChannels      () const noexcept                   { return outputNum; }
+        inline               float  coefficient         (const std::uint8_t output,
+                                                         const std::uint8_t input) const noexcept { return coefficients[output * inputNum + input]; }
+
+        template<typename T>
+                              void  apply               (const T*           in,
+                                                               T*           out,
+                                                         const std::size_t  frames) const;
+};
+
+inline channelMatrix::channelMatrix(const std::uint8_t inputChannels,
+                                    const std::uint8_t outputChannels)
+    :   kind        (matrixKind::generic),
+        inputNum    (inputChannels),
+        outputNum   (outputChannels),
+        coefficients(static_cast<std::size_t>(inputChannels) * outputChannels, 0.0f)
+{
+    constexpr float minus3dB = 0.70710678f;
+    auto set = [this](std::uint8_t o, std::uint8_t i, float gain) { coefficients[o * inputNum + i] = gain; };
+
+    if (inputChannels == outputChannels)
+    {
+        kind = matrixKind::identity;
+        for (std::uint8_t c = 0; c < inputChannels; c++) set(c, c, 1.0f);
+    }
+    else if (inputChannels == 1 && outputChannels == 2)
+    {
+        kind = matrixKind::monoToStereo;
+        set(0, 0, 1.0f);
+        set(1, 0, 1.0f);
+    }
+    else if (inputChannels == 2 && outputChannels == 1)
+    {
+        kind = matrixKind::stereoToMono;
+        set(0, 0, 0.5f);
+        set(0, 1, 0.5f);
+    }
+    else if ((inputChannels == 6 || inputChannels == 8) && outputChannels == 2)
+    {
+        // ITU-R BS.775 downmix, LFE is dropped.
+        kind = matrixKind::surroundToStereo;
+        set(0, 0, 1.0f);     set(1, 1, 1.0f);
+        set(0, 2, minus3dB); set(1, 2, minus3dB);
+        set(0, 4, minus3dB); set(1, 5, minus3dB);
+        if (inputChannels == 8)
+        {
+            set(0, 6, minus3dB);
+            set(1, 7, minus3dB);
+        }
+    }
+    else if (inputChannels == 1)
+    {
+        // Mono into a multichannel layout feeds the front pair.
+        set(0, 0, 1.0f);
+        set(1, 0, 1.0f);
+    }
+    else if (inputChannels < outputChannels)
+    {
+        // Up-mix keeps every input on the output channel of the same index and leaves the others silent.
+        for (std::uint8_t c = 0; c < inputChannels; c++) set(c, c, 1.0f);
+    }
+    else
+    {
+        // Down-mix folds input channel i onto output channel i % outputChannels and averages each output.
+        std::vector<std::uint8_t> folded(outputChannels, 0);
+        for (std::uint8_t c = 0; c < inputChannels; c++) folded[c % outputChannels]++;
+        for (std::uint8_t c = 0; c < inputChannels; c++) set(c % outputChannels, c, 1.0f / folded[c % outputChannels]);
+    }
+}
+
+template<typename T>
+void channelMatrix::apply(const T*          in,
+                                T*          out,
+                          const std::size_t frames) const
+{
+    if (kind == matrixKind::identity)
+    {
+        std::memcpy(out, in, frames * inputNum * sizeof(T));
+        return;
+    }
+    if constexpr (std::same_as<T, float>)
+    {
+        switch (kind)
+        {
+            case matrixKind::monoToStereo :
+                monoToStereo(in, out, frames, coefficient(0, 0), coefficient(1, 0));
+                return;
+            case matrixKind::stereoToMono :
+                stereoToMono(in, out, frames, coefficient(0, 0), coefficient(0, 1));
+                return;
+            case matrixKind::surroundToStereo :
+            {
+                float leftRow[8] = {}, rightRow[8] = {};
+                std::copy_n(coefficients.data()           , inputNum, leftRow );
+                std::copy_n(coefficients.data() + inputNum, inputNum, rightRow);
+                surroundToStereo(in, out, frames, inputNum, leftRow, rightRow);
+                return;
+            }
+            default :
+                break;
+        }
+    }
+    for (std::size_t f = 0; f < frames; f++)
+    {
+        const auto* frameIn  = in  + f * inputNum;
+              auto* frameOut = out + f * outputNum;
+        for (std::uint8_t o = 0; o < outputNum; o++)
+        {
+            const auto* row = coefficients.data() + o * inputNum;
+            sampleAccumulator<T> acc = 0;
+            for (std::uint8_t i = 0; i < inputNum; i++)
+                acc += row[i] * static_cast<sampleAccumulator<T>>(frameIn[i]);
+            frameOut[o] = sampleCast<T>(acc);
+        }
+    }
+}
+
+#endif// AUDIO_KERNELS_H
@@ -1,216 +1,831 @@
 #ifndef AUDIO_QUEUE_H
 #define AUDIO_QUEUE_H
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
+#include <cmath>
 #include <concepts>
+#include <limits>
+#include <cstring>
+#include <memory>
+#include <numbers>
 #include <print>
+#include <span>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "samplerate.h"
 
+#include "audioKernels.h"
 #include "queueBlocker.h"
 
 template<typename T>
-concept audioType = std::same_as<T, short> || std::same_as<T, float>;
+concept audioType = std::same_as<T, short>        || std::same_as<T, int24>  ||
+                    std::same_as<T, std::int32_t> || std::same_as<T, float>  || std::same_as<T, double>;
+
+/**
+ * @brief libsamplerate converter used by a queue, from the most accurate to the cheapest.
+ */
+enum class resampleQuality : int
+{
+    best    = SRC_SINC_BEST_QUALITY,
+    medium  = SRC_SINC_MEDIUM_QUALITY,
+    fastest = SRC_SINC_FASTEST,
+    linear  = SRC_LINEAR
+};
+
+// Drift controller tuning : fill level in percent in, ratio correction out, clamped to +-0.5%.
+constexpr auto DRIFT_KP      = 2e-4;
+constexpr auto DRIFT_KI      = 2e-7;
+constexpr auto DRIFT_KD      = 0.0;
+constexpr auto DRIFT_TARGET  = 50.0;
+constexpr auto DRIFT_LIMIT   = 0.005;
 
 template <audioType T>
 class audioQueue 
 {
     private :
+    // One ring allocation, replaced as a whole when the queue grows so a reader never sees a half resized ring.
+    struct ringStorage
+    {
+        std::unique_ptr<T[]> data;
+        std::  size_t        size;
+        std::  size_t        mask;
+
+        explicit ringStorage(const std::size_t capacity)
+            :   data(capacity == 0 ? nullptr : std::make_unique<T[]>(capacity)),
+                size(capacity),
+                mask(capacity == 0 ? 0 : capacity - 1) {}
+    };
  
     inline   static                                     std::uint32_t   queueCount = 0;
+    constexpr static                                    std::  size_t   cacheLineSize = 64;
+    inline   static                                     ringStorage     emptyRing { 0 };
+
+    // Ring storage : the producer owns it and retires the old one after a growth, everyone reads it through ring.
+    // ringSize mirrors its size for monitoring, which must not dereference a ring it is not reading from.
+                                    std::unique_ptr<ringStorage>        storage;
+                                            std::atomic<ringStorage*>   ring;
+                                            std::atomic<std::  size_t>  ringSize;
 
-                                                        std::vector<T>  queue;
+    // Consumer owned line : head is only written by pop, tail is cached locally and reloaded when the queue looks empty.
+    // readEpoch is odd while the consumer is inside the ring, a storage swap waits for it to move before freeing.
+    // The consumer side statistics live here too : the fill is lowest right after a read, so only the consumer tracks minFill.
+    alignas(cacheLineSize)                  std::atomic<std::  size_t>  head;
+                                                        std::  size_t   cachedTail;
+                                            std::array<float, 2>        appliedGain;
+                                            std::atomic<std::uint64_t>  readEpoch;
+                                            std::atomic<std::uint64_t>  underrunCount;
+                                            std::atomic<std::uint64_t>  dropCount;
+                                            std::atomic<std::  size_t>  minFill;
+                                            std::atomic<bool>           prefilling;
 
-                                            std::atomic<std::  size_t>  head;
-                                            std::atomic<std::  size_t>  tail;                
-                                            std::atomic<std::  size_t>  elementCount;
+    // Producer owned line : tail is only written by push, head is cached locally and reloaded when the queue looks full.
+    // flushMark is the tail at the last flush, the consumer skips everything before it.
+    // The fill is highest right after a write, so only the producer tracks maxFill.
+    // allocationCount counts the heap allocations made on the producer side : ring growth, converter and work buffers.
+    alignas(cacheLineSize)                  std::atomic<std::  size_t>  tail;
+                                                        std::  size_t   cachedHead;
+                                            std::atomic<std::  size_t>  flushMark;
+                                            std::atomic<std::  size_t>  burstFrames;
+                                            std::atomic<std::  size_t>  maxFill;
+                                            std::atomic<std::uint64_t>  overrunCount;
+                                            std::atomic<std::uint64_t>  allocationCount;
 
-                                                        std::uint32_t   audioSampleRate;
-    
+    // Read mostly line : stream format and jitter buffer latency target in frames (0 disables it).
+    alignas(cacheLineSize)                              std::uint32_t   audioSampleRate;
                                                         std:: uint8_t   channelNum;
-                                            std::atomic<std:: uint8_t>  usage;
-                                            std::atomic<std:: uint8_t>  inputDelay;
-                                            std::atomic<std:: uint8_t>  outputDelay;
+                                            std::atomic<std::  size_t>  targetLatency;
+
+    // Streaming resampler owned by the producer, its filter history is carried from one push to the next.
+                                                        SRC_STATE*      srcState;
+                                                        resampleQuality srcQuality;
+                                                        std::uint32_t   srcInputRate;
+                                                    std::vector<float>  resampleInput;      // Float input of the converter, non float queues only
+                                                    std::vector<float>  resampleStaging;    // Float output of the converter, non float queues only
+    constexpr static                                    std::  size_t   resampleHeadroom = 64;
+
+    // Clock drift compensation : the fill level drives a PID that nudges the resampling ratio around 1.
+                                                        queueBlocker    driftController;
+                                                        bool            driftCompensation;
+                                            std::atomic<double>         driftRatio;
+
+    // Mix controls written by any thread, the consumer ramps from appliedGain towards them over one mix call.
+                                            std::atomic<float>          sourceGain;
+                                            std::atomic<float>          sourcePan;
+                                            std::atomic<bool>           sourceMuted;
+
+    // Channel mapping from the last pushed input layout, rebuilt only when that layout changes.
+                                                        channelMatrix   channelMap;
+                                                        std::vector<T>  conversionBuffer;
+                                                        std::vector<T>  inputBuffer;        // Float input of a non float queue, converted at the edge
                                 
     public : 
+    // Writable part of the ring handed to a producer, split in two spans when it crosses the end of the storage.
+    struct writeRegion
+    {
+        std::span<T> first;
+        std::span<T> second;
+
+        inline std::size_t size() const noexcept { return first.size() + second.size(); }
+    };
+
+    // Snapshot of the jitter buffer state for monitoring, fill levels are in frames.
+    struct queueStatistics
+    {
+        std::  size_t fill;
+        std::  size_t minFill;
+        std::  size_t maxFill;
+        std::  size_t targetLatency;
+        std::uint64_t underruns;
+        std::uint64_t overruns;
+    };
+
   /*inline    Return Type    Function            const  Argument Type    Argument               const  noexcept      Implementation*/
 
                              audioQueue         ();
                              audioQueue         (const  std::uint32_t    sampleRate,
                                                  const  std:: uint8_t    channelNumbers,
-                                                 const  std::  size_t    frames);
+                                                 const  std::  size_t    frames,
+                                                 const resampleQuality   quality = resampleQuality::best);
                              audioQueue         (const   audioQueue<T>  &other);
                              audioQueue         (        audioQueue<T> &&other)                        noexcept;
-                            ~audioQueue         ()                                                                  { queueCount--; std::print("object dystroyed. total object count : {}\n", queueCount); }
+                            ~audioQueue         ()                                                                  { resetResampler(); queueCount--; std::print("object dystroyed. total object count : {}\n", queueCount); }
 
                        bool  push               (const              T*   ptr, 
                                                  const  std::  size_t    frames,
                                                  const  std:: uint8_t    outputChannelNum,
                                                  const  std::uint32_t    outputSampleRate);
+                       bool  push               (const          float*   ptr, 
+                                                 const  std::  size_t    frames,
+                                                 const  std:: uint8_t    outputChannelNum,
+                                                 const  std::uint32_t    outputSampleRate)     requires (!std::same_as<T, float>);
                        bool  pop                (                   T*  &ptr, 
                                                  const  std::  size_t    frames,
                                                  const           bool    mode);
+    inline    std::  size_t  mixInto            (                   T*   out,
+                                                 const  std::  size_t    frames,
+                                                 const          float    gain = 1.0f)                               { return mixBus(out, frames, gain); }
+    inline    std::  size_t  mixInto            (               float*   out,
+                                                 const  std::  size_t    frames,
+                                                 const          float    gain = 1.0f)  requires (!std::same_as<T, float>) { return mixBus(out, frames, gain); }
+                writeRegion  reserveWrite       (const  std::  size_t    frames);
+                       void  commitWrite        (const  std::  size_t    frames);
+                       void  flush              ();
 
     inline             void  setSampleRate      (const  std::uint32_t    sRate)                        noexcept     { audioSampleRate = sRate; }
-    inline             void  setChannelNum      (const  std:: uint8_t    cNum )                        noexcept     { channelNum = cNum; }
+    inline             void  setChannelNum      (const  std:: uint8_t    cNum )                        noexcept     { channelNum = cNum; resetResampler(); }
+    inline             void  setGain            (const          float    gain)                         noexcept     { sourceGain.store(gain, std::memory_order_relaxed); }
+    inline             void  setPan             (const          float    pan)                          noexcept     { sourcePan.store(std::clamp(pan, -1.0f, 1.0f), std::memory_order_relaxed); }
+    inline             void  setMute            (const           bool    mute)                         noexcept     { sourceMuted.store(mute, std::memory_order_relaxed); }
+                       void  setTargetLatency   (const  std::  size_t    frames)                       noexcept;
+    inline             void  setDriftControl    (const           bool    enable)                       noexcept     { driftCompensation = enable; driftController.reset(); driftRatio.store(1.0); }
+    inline             void  setResampleQuality (const resampleQuality   quality)                      noexcept     { srcQuality = quality; resetResampler(); }
                        void  setCapacity        (const  std::  size_t    newCapacity);                  
+    inline             void  growCapacity       (const  std::  size_t    minimum)                                   { if (minimum > capacity()) setCapacity(std::max(roundCapacity(minimum), capacity() * 2)); }
 
-    inline             bool  empty              ()                                              const  noexcept     { return usage.load() == 0; }
-    inline    std::  size_t  size               ()                                              const  noexcept     { return elementCount.load(); }
+    inline             bool  empty              ()                                              const  noexcept     { return size() == 0; }
+    inline    std:: uint8_t  usage              ()                                              const  noexcept     { const auto c = capacity(); return c == 0 ? 0 : static_cast<std::uint8_t>(size() * 100 / c); }
+    inline    std::  size_t  size               ()                                              const  noexcept     { const auto h = head.load(std::memory_order_acquire); return tail.load(std::memory_order_acquire) - h; }
+    inline    std::  size_t  capacity           ()                                              const  noexcept     { return ringSize.load(std::memory_order_relaxed); }
     inline    std:: uint8_t  channels           ()                                              const  noexcept     { return channelNum; }
     inline    std::uint32_t  sampleRate         ()                                              const  noexcept     { return audioSampleRate; }
-    inline    std::uint32_t  getInputDelay      ()                                              const  noexcept     { return inputDelay; }
-    inline    std::uint32_t  getoutputDelay     ()                                              const  noexcept     { return outputDelay; }
+    inline            float  getGain            ()                                              const  noexcept     { return sourceGain.load(std::memory_order_relaxed); }
+    inline            float  getPan             ()                                              const  noexcept     { return sourcePan.load(std::memory_order_relaxed); }
+    inline             bool  isMuted            ()                                              const  noexcept     { return sourceMuted.load(std::memory_order_relaxed); }
+    inline  resampleQuality  getResampleQuality ()                                              const  noexcept     { return srcQuality; }
+    inline           double  getDriftRatio      ()                                              const  noexcept     { return driftRatio.load(std::memory_order_relaxed); }
+    inline             bool  isDriftCompensated ()                                              const  noexcept     { return driftCompensation; }
+    inline    std::  size_t  getTargetLatency   ()                                              const  noexcept     { return targetLatency.load(std::memory_order_relaxed); }
+            queueStatistics  statistics         (const           bool    reset = false)                noexcept;
+    inline    std::uint64_t  getUnderrunCount   ()                                              const  noexcept     { return underrunCount.load(std::memory_order_relaxed); }
+    inline    std::uint64_t  getAllocationCount ()                                              const  noexcept     { return allocationCount.load(std::memory_order_relaxed); }
 
     static    std::uint32_t  getCount           ()                                                     noexcept     { return queueCount; }
 
     private :
-                       bool  enqueue            (const              T    value);
-                       bool  dequeue            (                   T   &value,
+                writeRegion  reserveSamples     (const  std::  size_t    count);
+                       void  driftRefresh       ();
+                       bool  jitterGate         (const  std::  size_t    frames);
+                       bool  pushFinish         (const  std::  size_t    frames,
+                                                 const           bool    written);
+    template<typename O>
+              std::  size_t  mixBus             (                   O*   out,
+                                                 const  std::  size_t    frames,
+                                                 const          float    gain);
+                       bool  enqueue            (const              T*   src,
+                                                 const  std::  size_t    count);
+              std::  size_t  dequeue            (                   T*   dst,
+                                                 const  std::  size_t    count,
                                                  const           bool    mode);
+    template<typename F>
+              std::  size_t  consume            (const  std::  size_t    count,
+                                                                   F   &&spanOperation);
+    static             void  copyBlock          (                   T*   dst,
+                                                 const              T*   src,
+                                                 const  std::  size_t    count,
+                                                 const           bool    mode)                         noexcept;
                        void  clear              ();
-                       void  usageRefresh       (); 
-                       void  resample           (       std::vector<T>  &data,
+    template<typename V>
+                       void  bufferGrow         (   std::vector<V>  &buffer,
+                                                 const  std::  size_t    count);
+                       void  storageSwap        (std::unique_ptr<ringStorage>    next);
+    static    std::  size_t  roundCapacity      (const  std::  size_t    requested)                    noexcept     { return requested == 0 ? 0 : std::bit_ceil(requested); }
+                       void  maxFillRefresh     ()                                                     noexcept;
+                       void  minFillRefresh     ()                                                     noexcept;
+                       bool  enqueueResampled   (const          float*   data,
                                                  const  std::  size_t    frames,
                                                  const  std::uint32_t    inputSampleRate);
-                       void  channelConversion  (       std::vector<T>  &data,
+                       bool  enqueueMapped      (const          float*   data,
+                                                 const  std::  size_t    frames,
+                                                 const  std:: uint8_t    inputChannelNum,
+                                                 const  std::uint32_t    inputSampleRate);
+                       long  resampleSpan       (            SRC_DATA   &srcData,
+                                                                float*   out,
+                                                 const  std::  size_t    frames);
+    inline             void  resetResampler     ()                                                     noexcept     { if (srcState) srcState = src_delete(srcState); }
+        std::span<const T>  channelConversion  (const              T*   data,
+                                                 const  std::  size_t    frames,
+                                                 const  std:: uint8_t    inputChannelNum);
+                       bool  enqueueConverted   (const              T*   src,
+                                                 const  std::  size_t    frames,
                                                  const  std:: uint8_t    inputChannelNum);
+                       void  channelMapRefresh  (const  std:: uint8_t    inputChannelNum);
+       std::array<float, 2>  targetGain         (const          float    gain)                  const  noexcept;
                        
 };
 
 #pragma region Constructors
 template<audioType T>
 inline audioQueue<T>::audioQueue()
-    :   queue           (0),  
-        audioSampleRate (0), 
-        channelNum      (0),
+    :   storage         (nullptr),
+        ring            (&emptyRing),
+        ringSize        (0),
         head            (0), 
+        cachedTail      (0),
+        appliedGain     ({ 1.0f, 1.0f }),
+        readEpoch       (0),
+        underrunCount   (0),
+        dropCount       (0),
+        minFill         (std::numeric_limits<std::size_t>::max()),
+        prefilling      (false),
         tail            (0), 
-        usage           (0), 
-        elementCount    (0),
-        inputDelay      (0),
-        outputDelay     (0){ queueCount ++; std::print("object created by default constructor.total object count : {}\n", queueCount); }
+        cachedHead      (0),
+        flushMark       (0),
+        burstFrames     (0),
+        maxFill         (0),
+        overrunCount    (0),
+        allocationCount (0),
+        audioSampleRate (0), 
+        channelNum      (0),
+        targetLatency   (0),
+        srcState        (nullptr),
+        srcQuality      (resampleQuality::best),
+        srcInputRate    (0),
+        driftController (DRIFT_KP, DRIFT_KI, DRIFT_KD, DRIFT_TARGET, DRIFT_LIMIT),
+        driftCompensation(false),
+        driftRatio      (1.0),
+        sourceGain      (1.0f),
+        sourcePan       (0.0f),
+        sourceMuted     (false),
+        channelMap      (){ queueCount ++; std::print("object created by default constructor.total object count : {}\n", queueCount); }
 
 template<audioType T>
 inline audioQueue<T>::audioQueue(const std::uint32_t sampleRate, 
                                  const std:: uint8_t channelNumbers, 
-                                 const std::  size_t frames)
-    :   queue           (frames * channelNumbers),
-        audioSampleRate (sampleRate), 
-        channelNum      (channelNumbers),
+                                 const std::  size_t frames,
+                                 const resampleQuality quality)
+    :   storage         (std::make_unique<ringStorage>(roundCapacity(frames * channelNumbers))),
+        ring            (storage.get()),
+        ringSize        (storage->size),
         head            (0), 
+        cachedTail      (0),
+        appliedGain     ({ 1.0f, 1.0f }),
+        readEpoch       (0),
+        underrunCount   (0),
+        dropCount       (0),
+        minFill         (std::numeric_limits<std::size_t>::max()),
+        prefilling      (false),
         tail            (0),
-        usage           (0),
-        elementCount    (0),
-        inputDelay      (0),
-        outputDelay     (0){ queueCount ++; }
+        cachedHead      (0),
+        flushMark       (0),
+        burstFrames     (0),
+        maxFill         (0),
+        overrunCount    (0),
+        allocationCount (0),
+        audioSampleRate (sampleRate), 
+        channelNum      (channelNumbers),
+        targetLatency   (0),
+        srcState        (nullptr),
+        srcQuality      (quality),
+        srcInputRate    (0),
+        driftController (DRIFT_KP, DRIFT_KI, DRIFT_KD, DRIFT_TARGET, DRIFT_LIMIT),
+        driftCompensation(false),
+        driftRatio      (1.0),
+        sourceGain      (1.0f),
+        sourcePan       (0.0f),
+        sourceMuted     (false),
+        channelMap      ()
+{ 
+    // Start at the resting gain of the layout, a centered stereo source is -3 dB and must not ramp down from unity on its first mix.
+    appliedGain = targetGain(1.0f);
+    queueCount ++; 
+}
 
 template<audioType T>
 inline audioQueue<T>::audioQueue(const audioQueue<T>& other)
     :
-        queue           (other.queue),
+        storage         (std::make_unique<ringStorage>(other.capacity())),
+        ring            (storage.get()),
+        ringSize        (storage->size),
         head            (other.head.load()),
+        cachedTail      (other.cachedTail),
+        appliedGain     (other.appliedGain),
+        readEpoch       (0),
+        underrunCount   (0),
+        dropCount       (0),
+        minFill         (std::numeric_limits<std::size_t>::max()),
+        prefilling      (false),
         tail            (other.tail.load()),
-        elementCount    (other.elementCount.load()),
+        cachedHead      (other.cachedHead),
+        flushMark       (other.flushMark.load()),
+        burstFrames     (0),
+        maxFill         (0),
+        overrunCount    (0),
+        allocationCount (0),
         audioSampleRate (other.audioSampleRate),
         channelNum      (other.channelNum),
-        usage           (other.usage.load()),
-        inputDelay      (0),
-        outputDelay     (0){ queueCount++; }
+        targetLatency   (0),
+        srcState        (nullptr),
+        srcQuality      (other.srcQuality),
+        srcInputRate    (0),
+        driftController (other.driftController),
+        driftCompensation(other.driftCompensation),
+        driftRatio      (other.driftRatio.load()),
+        sourceGain      (other.sourceGain.load()),
+        sourcePan       (other.sourcePan.load()),
+        sourceMuted     (other.sourceMuted.load()),
+        channelMap      (other.channelMap)
+{ 
+    std::copy_n(other.ring.load()->data.get(), capacity(), storage->data.get());
+    queueCount++; 
+}
 
 template<audioType T>
 inline audioQueue<T>::audioQueue(audioQueue<T> &&other) noexcept
     :
-        queue           (std::move(other.queue)),
+        storage         (std::move(other.storage)),
+        ring            (other.ring.exchange(&emptyRing)),
+        ringSize        (other.ringSize.exchange(0)),
         head            (other.head.load()),
+        cachedTail      (other.cachedTail),
+        appliedGain     (other.appliedGain),
+        readEpoch       (0),
+        underrunCount   (other.underrunCount.load()),
+        dropCount       (other.dropCount.load()),
+        minFill         (other.minFill.load()),
+        prefilling      (other.prefilling.load()),
         tail            (other.tail.load()),
-        elementCount    (other.elementCount.load()),
+        cachedHead      (other.cachedHead),
+        flushMark       (other.flushMark.load()),
+        burstFrames     (other.burstFrames.load()),
+        maxFill         (other.maxFill.load()),
+        overrunCount    (other.overrunCount.load()),
+        allocationCount (other.allocationCount.load()),
         audioSampleRate (other.audioSampleRate),
         channelNum      (other.channelNum),
-        usage           (other.usage.load()),
-        inputDelay      (0),
-        outputDelay     (0){ queueCount++; }
+        targetLatency   (other.targetLatency.load()),
+        srcState        (std::exchange(other.srcState, nullptr)),
+        srcQuality      (other.srcQuality),
+        srcInputRate    (other.srcInputRate),
+        resampleInput   (std::move(other.resampleInput)),
+        resampleStaging (std::move(other.resampleStaging)),
+        driftController (other.driftController),
+        driftCompensation(other.driftCompensation),
+        driftRatio      (other.driftRatio.load()),
+        sourceGain      (other.sourceGain.load()),
+        sourcePan       (other.sourcePan.load()),
+        sourceMuted     (other.sourceMuted.load()),
+        channelMap      (std::move(other.channelMap)),
+        conversionBuffer(std::move(other.conversionBuffer)),
+        inputBuffer     (std::move(other.inputBuffer)){ queueCount++; }
 
 
 #pragma endregion
 
 #pragma region Private member functions
 template<audioType T>
-bool audioQueue<T>::enqueue(const T value)
+inline void audioQueue<T>::copyBlock(      T*          dst, 
+                                     const T*          src, 
+                                     const std::size_t count, 
+                                     const bool        mode) noexcept
+{
+    if (!mode) 
+        std::memcpy(dst, src, count * sizeof(T));
+    else 
+        mixScaled(dst, src, count, 1.0f);
+}
+
+template<audioType T>
+typename audioQueue<T>::writeRegion audioQueue<T>::reserveSamples(const std::size_t count)
 {
-    auto currentTail = tail.load(std::memory_order_relaxed);
-    auto nextTail    = (currentTail + 1) % queue.size();
+    const auto &current  = *ring.load(std::memory_order_relaxed);
+    const auto  capacity = current.size;
+    if (capacity == 0 || count == 0) return {};
 
-    if (nextTail == head.load(std::memory_order_acquire)) 
-        return false; // Queue is full
+    // Indices run freely and are masked on access, so tail - head is always the element count.
+    const auto currentTail = tail.load(std::memory_order_relaxed);
+    if (capacity - (currentTail - cachedHead) < count)
+    {
+        cachedHead = head.load(std::memory_order_acquire);
+        if (capacity - (currentTail - cachedHead) < count)
+            return {}; // Queue is full
+    }
+
+    const auto offset    = currentTail & current.mask;
+    const auto firstSpan = std::min(count, capacity - offset);
+    return { std::span<T>(current.data.get() + offset, firstSpan), 
+             std::span<T>(current.data.get()         , count - firstSpan) };
+}
 
-    queue[currentTail] = value;
-    tail        .store      (nextTail, std::memory_order_release);
-    elementCount.fetch_add  (       1, std::memory_order_relaxed);
+template<audioType T>
+inline void audioQueue<T>::driftRefresh()
+{
+    const auto capacity = ring.load(std::memory_order_relaxed)->size;
+    if (!driftCompensation || capacity == 0) return;
+    // With a jitter buffer the controller holds the fill seen by the producer at the latency target.
+    if (const auto target = targetLatency.load(std::memory_order_relaxed))
+        driftController.setTarget(std::min(100.0, static_cast<double>(target) * channelNum / capacity * 100.0));
+    const auto fillLevel = static_cast<double>(size()) / capacity * 100.0;
+    driftRatio.store(driftController.ratioCalculate(fillLevel), std::memory_order_relaxed);
+}
+
+template<audioType T>
+bool audioQueue<T>::jitterGate(const std::size_t frames)
+{
+    const auto target = targetLatency.load(std::memory_order_relaxed);
+    if (target == 0) return true;
+
+    const auto available = size() / channelNum;
+    if (prefilling.load(std::memory_order_relaxed))
+    {
+        if (available < target) return false; // Still buffering, the caller plays silence
+        prefilling.store(false, std::memory_order_relaxed);
+    }
+
+    // Controlled drop : a queue grown beyond one producer burst over the target is brought back to the target.
+    const auto highWater = target + burstFrames.load(std::memory_order_relaxed) + frames;
+    if (available > highWater)
+    {
+        consume((available - target) * channelNum, [](const std::size_t, const T*, const std::size_t) {});
+        dropCount.fetch_add(1, std::memory_order_relaxed);
+    }
     return true;
 }
 
+/**
+ * @brief Producer side bookkeeping common to every push, returns written.
+ */
 template<audioType T>
-bool audioQueue<T>::dequeue(         T &value, 
-                            const bool  mode)
+bool audioQueue<T>::pushFinish(const std::size_t frames,
+                               const bool        written)
 {
-    auto currentHead =  head.load(std::memory_order_relaxed);
+    if (frames > burstFrames.load(std::memory_order_relaxed))
+        burstFrames.store(frames, std::memory_order_relaxed);
+    if (!written)
+    {
+        overrunCount.fetch_add(1, std::memory_order_relaxed);
+        std::print(stderr,"push aborted, no enough space.\n");
+    }
+    maxFillRefresh();
+    return written;
+}
 
-    if ( currentHead == tail.load(std::memory_order_acquire)) 
-        return false; // Queue is empty
+template<audioType T>
+bool audioQueue<T>::enqueue(const T*          src, 
+                            const std::size_t count)
+{
+    const auto region = reserveSamples(count);
+    if (region.size() != count || count == 0) 
+        return false;
+
+    // Copy into the ring in at most two contiguous spans, then publish the new tail once.
+    copyBlock(region.first .data(), src                      , region.first .size(), false);
+    copyBlock(region.second.data(), src + region.first.size(), region.second.size(), false);
 
-    if (!mode) value  = queue[currentHead];
-    else       value += queue[currentHead];
-    head        .store      ((currentHead + 1) % queue.size(), std::memory_order_release);
-    elementCount.fetch_sub  (                               1, std::memory_order_relaxed);
+    tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
     return true;
 }
 
+template<audioType T>
+template<typename F>
+std::size_t audioQueue<T>::consume(const std::size_t count,
+                                         F         &&spanOperation)
+{
+    auto currentHead = head.load(std::memory_order_relaxed);
+    if (const auto mark = flushMark.load(std::memory_order_acquire); mark > currentHead)
+    {
+        // Flushed samples are skipped, the tail is at least at the mark once the mark is visible.
+        currentHead = mark;
+        head.store(mark, std::memory_order_release);
+        if (cachedTail < mark) cachedTail = tail.load(std::memory_order_acquire);
+    }
+    if (cachedTail - currentHead < count)
+        cachedTail = tail.load(std::memory_order_acquire);
+
+    const auto readCount = std::min(count, cachedTail - currentHead);
+    if (readCount == 0)
+        return 0; // Queue is empty
+
+    // The ring is loaded after the tail : samples up to any tail already seen are present in the old and the new storage.
+    // Entering the epoch before that load keeps a retired storage alive until this read is over.
+    const auto epoch     = readEpoch.fetch_add(1, std::memory_order_seq_cst);
+    const auto &current  = *ring.load(std::memory_order_seq_cst);
+
+    // Hand the readable part to the caller in at most two contiguous spans, then publish the new head once.
+    const auto offset    = currentHead & current.mask;
+    const auto firstSpan = std::min(readCount, current.size - offset);
+    spanOperation(std::size_t{ 0 }, current.data.get() + offset, firstSpan            );
+    spanOperation(firstSpan       , current.data.get()         , readCount - firstSpan);
+
+    readEpoch.store(epoch + 2, std::memory_order_release);
+    head.store(currentHead + readCount, std::memory_order_release);
+    return readCount;
+}
+
+template<audioType T>
+inline std::size_t audioQueue<T>::dequeue(      T*          dst, 
+                                          const std::size_t count,
+                                          const bool        mode)
+{
+    return consume(count, [dst, mode](const std::size_t offset, const T* src, const std::size_t n) { copyBlock(dst + offset, src, n, mode); });
+}
+
+/**
+ * @brief Grow a producer side work buffer to at least count elements, counting the allocation.
+ */
+template<audioType T>
+template<typename V>
+inline void audioQueue<T>::bufferGrow(      std::vector<V> &buffer,
+                                      const std::size_t     count)
+{
+    if (buffer.size() >= count) return;
+    buffer.resize(count);
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+}
+
 template<audioType T>
 inline void audioQueue<T>::clear()
 {
     head        .store(0);
     tail        .store(0);
-    elementCount.store(0);
+    flushMark   .store(0);
+    cachedHead  = 0;
+    cachedTail  = 0;
+}
+
+template<audioType T>
+void audioQueue<T>::storageSwap(std::unique_ptr<ringStorage> next)
+{
+    // Publish first, then wait until a read that may still hold the old ring has left it. Only the producer waits.
+    auto retired = std::exchange(storage, std::move(next));
+    ring    .store(storage ? storage.get() : &emptyRing, std::memory_order_seq_cst);
+    ringSize.store(storage ? storage->size : 0        , std::memory_order_relaxed);
+    const auto epoch = readEpoch.load(std::memory_order_seq_cst);
+    if (epoch % 2 != 0)
+        while (readEpoch.load(std::memory_order_acquire) == epoch) std::this_thread::yield();
 }
 
+/**
+ * @brief Producer side : record the fill after a write. Only touches the producer line, 
+ * compare exchange keeps a reset made meanwhile by statistics.
+ */
 template<audioType T>
-inline void audioQueue<T>::usageRefresh() 
+inline void audioQueue<T>::maxFillRefresh() noexcept
 { 
-    if (queue.size() == 0) return;
-    auto newUsage = static_cast<double>(elementCount.load()) / queue.size() * 100.0;
-    usage.store(static_cast<std::uint8_t>(newUsage)); 
+    if (channelNum == 0) return;
+    const auto fill = size() / channelNum;
+    auto high = maxFill.load(std::memory_order_relaxed);
+    while (fill > high && !maxFill.compare_exchange_weak(high, fill, std::memory_order_relaxed)) {}
 }
 
+/**
+ * @brief Consumer side : record the fill after a read. Only touches the consumer line.
+ */
 template<audioType T>
-void audioQueue<T>::resample(      std::vector<T> &data, 
-                             const std::  size_t   frames, 
-                             const std::uint32_t   inputSampleRate)
+inline void audioQueue<T>::minFillRefresh() noexcept
+{ 
+    if (channelNum == 0) return;
+    const auto fill = size() / channelNum;
+    auto low  = minFill.load(std::memory_order_relaxed);
+    while (fill < low  && !minFill.compare_exchange_weak(low , fill, std::memory_order_relaxed)) {}
+}
+
+/**
+ * @brief Run the converter on the input left in srcData into frames frames at out, returns the frames generated, -1 on error.
+ */
+template<audioType T>
+long audioQueue<T>::resampleSpan(      SRC_DATA    &srcData,
+                                       float*       out,
+                                 const std::size_t  frames)
 {
-    const auto resampleRatio = static_cast<double>(audioSampleRate) / inputSampleRate;
-    const auto newSize       = static_cast<size_t>(frames * channelNum * resampleRatio);
-    std::vector<T> temp(newSize);
+    if (frames == 0) return 0;
+    srcData.data_out      = out;
+    srcData.output_frames = static_cast<long>(frames);
+    if (const auto error = src_process(srcState, &srcData))
+    {
+        std::print(stderr, "libsamplerate error : {}.\n", src_strerror(error));
+        return -1;
+    }
+    srcData.data_in      += srcData.input_frames_used * channelNum;
+    srcData.input_frames -= srcData.input_frames_used;
+    return srcData.output_frames_gen;
+}
 
-    SRC_STATE* srcState = src_new(SRC_SINC_BEST_QUALITY, static_cast<int>(channelNum), nullptr);
+/**
+ * @brief Resample frames float frames in the queue layout into the ring, returns false on error or when the ring ran out of room.
+ *
+ * A float queue has libsamplerate write straight into the reserved ring region, one call per contiguous span.
+ * Any other format has it write into the staging buffer, converted once on its way into the ring.
+ */
+template<audioType T>
+bool audioQueue<T>::enqueueResampled(const float*        data, 
+                                     const std::  size_t frames, 
+                                     const std::uint32_t inputSampleRate)
+{
+    if (!srcState)
+    {
+        int error = 0;
+        srcState = src_new(static_cast<int>(srcQuality), static_cast<int>(channelNum), &error);
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        if (!srcState)
+        {
+            std::print(stderr, "libsamplerate error : {}.\n", src_strerror(error));
+            return false;
+        }
+    }
+    else if (inputSampleRate != srcInputRate) 
+        src_reset(srcState);
+    srcInputRate = inputSampleRate;
+
+    // The converter is never told the input has ended, so it keeps its filter history and 
+    // may hand back slightly more or fewer frames than the ratio predicts on each call.
+    const auto resampleRatio = static_cast<double>(audioSampleRate) / inputSampleRate * driftRatio.load(std::memory_order_relaxed);
+    const auto outputFrames  = static_cast<std::size_t>(frames * resampleRatio) + resampleHeadroom;
 
     SRC_DATA srcData;
-    srcData.end_of_input  = true;
-    srcData.data_in       = data.data();
-    srcData.data_out      = temp.data();
+    srcData.end_of_input  = 0;
+    srcData.data_in       = data;
     srcData.input_frames  = static_cast<long>(frames);
-    srcData.output_frames = static_cast<int> (frames * resampleRatio);
     srcData.src_ratio     = resampleRatio;
 
-    src_process(srcState, &srcData);
-    src_delete(srcState);
-    
-    data = std::move(temp);
+    std::size_t generated = 0;
+    if constexpr (std::same_as<T, float>)
+    {
+        // Room for the worst case if there is, otherwise whatever whole frames are left.
+        auto region = reserveSamples(outputFrames * channelNum);
+        if (region.size() == 0 && capacity() != 0)
+            region = reserveSamples((capacity() - (tail.load(std::memory_order_relaxed) - cachedHead)) / channelNum * channelNum);
+
+        // Whole frames go straight into each span, a frame straddling the wrap point is staged on the stack.
+        const auto firstFrames  = region.first.size() / channelNum;
+        const auto splitSamples = region.first.size() % channelNum;
+        auto       done         = resampleSpan(srcData, region.first.data(), firstFrames);
+        if (done < 0) return false;
+        generated = static_cast<std::size_t>(done);
+        auto spanFull = generated == firstFrames;
+        if (spanFull && splitSamples != 0)
+        {
+            std::array<float, 256> frame;
+            if ((done = resampleSpan(srcData, frame.data(), 1)) < 0) return false;
+            if (done == 1)
+            {
+                std::copy_n(frame.data()               , splitSamples             , region.first .data() + firstFrames * channelNum);
+                std::copy_n(frame.data() + splitSamples, channelNum - splitSamples, region.second.data());
+                generated++;
+            }
+            spanFull = done == 1;
+        }
+        if (spanFull)
+        {
+            const auto offset       = splitSamples == 0 ? 0 : channelNum - splitSamples;
+            const auto secondFrames = (region.second.size() - offset) / channelNum;
+            if ((done = resampleSpan(srcData, region.second.data() + offset, secondFrames)) < 0) return false;
+            generated += static_cast<std::size_t>(done);
+        }
+    }
+    else
+    {
+        bufferGrow(resampleStaging, outputFrames * channelNum);
+        const auto done = resampleSpan(srcData, resampleStaging.data(), outputFrames);
+        if (done < 0) return false;
+        generated = static_cast<std::size_t>(done);
+
+        const auto region = reserveSamples(generated * channelNum);
+        if (region.size() != generated * channelNum) return false;
+        samplesFromFloat(resampleStaging.data()                      , region.first .data(), region.first .size());
+        samplesFromFloat(resampleStaging.data() + region.first.size(), region.second.data(), region.second.size());
+    }
+
+    tail.store(tail.load(std::memory_order_relaxed) + generated * channelNum, std::memory_order_release);
+    return srcData.input_frames == 0; // Input left over : the ring ran out of room
+}
+
+/**
+ * @brief Map float input to the queue layout in float, then resample it : a non float queue quantizes it only once, into the ring.
+ */
+template<audioType T>
+bool audioQueue<T>::enqueueMapped(const float*        data, 
+                                  const std::  size_t frames, 
+                                  const std:: uint8_t inputChannelNum,
+                                  const std::uint32_t inputSampleRate)
+{
+    if (inputChannelNum != channelNum)
+    {
+        channelMapRefresh(inputChannelNum);
+        bufferGrow(resampleInput, frames * channelNum);
+        channelMap.apply(data, resampleInput.data(), frames);
+        data = resampleInput.data();
+    }
+    return enqueueResampled(data, frames, inputSampleRate);
+}
+
+template<audioType T>
+inline std::array<float, 2> audioQueue<T>::targetGain(const float gain) const noexcept
+{
+    if (sourceMuted.load(std::memory_order_relaxed)) 
+        return { 0.0f, 0.0f };
+
+    const auto level = sourceGain.load(std::memory_order_relaxed) * gain;
+    if (channelNum != 2) 
+        return { level, level };
+
+    // Constant power pan law, -3 dB at center and unity when hard panned, so panning never pushes a full scale source past it.
+    const auto angle = (sourcePan.load(std::memory_order_relaxed) + 1.0f) * std::numbers::pi_v<float> / 4;
+    return { level * std::cos(angle), 
+             level * std::sin(angle) };
+}
+
+template<audioType T>
+inline void audioQueue<T>::channelMapRefresh(const std::uint8_t inputChannelNum)
+{
+    if (channelMap.inputChannels() != inputChannelNum || channelMap.outputChannels() != channelNum)
+    {
+        channelMap = channelMatrix(inputChannelNum, channelNum);
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+template<audioType T>
+std::span<const T> audioQueue<T>::channelConversion(const T*            data, 
+                                                    const std::  size_t frames,
+                                                    const std:: uint8_t inputChannelNum)
+{
+    channelMapRefresh(inputChannelNum);
+    const auto count = frames * channelNum;
+    bufferGrow(conversionBuffer, count);
+
+    channelMap.apply(data, conversionBuffer.data(), frames);
+    return { conversionBuffer.data(), count };
 }
 
 template<audioType T>
-void audioQueue<T>::channelConversion(      std::vector<T> &data, 
-                                      const std:: uint8_t   inputChannelNum){}
+bool audioQueue<T>::enqueueConverted(const T*            src, 
+                                     const std::  size_t frames,
+                                     const std:: uint8_t inputChannelNum)
+{
+    channelMapRefresh(inputChannelNum);
+    const auto count  = frames * channelNum;
+    const auto region = reserveSamples(count);
+    if (region.size() != count || count == 0) 
+        return false;
+
+    // Whole frames are mapped straight into each span, a frame straddling the wrap point is staged on the stack.
+    const auto firstFrames  = region.first.size() / channelNum;
+    const auto splitSamples = region.first.size() % channelNum;
+    auto       remaining    = frames - firstFrames;
+    auto*      out          = region.second.data();
+
+    channelMap.apply(src, region.first.data(), firstFrames);
+    src += firstFrames * inputChannelNum;
+    if (splitSamples != 0)
+    {
+        std::array<T, 256> frame;
+        channelMap.apply(src, frame.data(), 1);
+        std::copy_n(frame.data()               , splitSamples             , region.first.data() + firstFrames * channelNum);
+        std::copy_n(frame.data() + splitSamples, channelNum - splitSamples, out);
+        out += channelNum - splitSamples;
+        src += inputChannelNum;
+        remaining--;
+    }
+    channelMap.apply(src, out, remaining);
+
+    tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    return true;
+}
 #pragma endregion
 
 #pragma region Public APIs
@@ -221,41 +836,58 @@ bool audioQueue<T>::push(const             T* ptr,
                          const std::uint32_t  inputSampleRate)
 {
     const bool needChannelConversion    = (inputChannelNum != channelNum);
-    const bool needResample             = (inputSampleRate != audioSampleRate);
+    const bool needResample             = (inputSampleRate != audioSampleRate) || driftCompensation;
     const auto currentSize              = frames * inputChannelNum;
 
-    std::vector<T> temp(ptr, ptr + currentSize);
-    /*if (needChannelConversion)
-        channelConversion(temp, ChannelNum);*/
-    if (needResample)
-        resample(temp, frames, inputSampleRate);
-
-    const auto estimatedUsage = usage.load() + (temp.size() * 100 / queue.size());
-    queueBlocker inputBlocker(0.1, 0.1, 0.01, 50);
-    const auto delayCoefficient = 0.5 / queueCount;
-    auto delayTime = static_cast<int>(delayCoefficient * inputBlocker.delayCalculate(estimatedUsage));
-    if (delayTime < 0)
+    driftRefresh();
+
+    bool written = false;
+    if (!needResample)
     {
-        if(-delayTime > inputDelay.load())
-            inputDelay.store(-delayTime);
+        // Data already in the queue format goes straight into the ring without an intermediate copy.
+        written = needChannelConversion ? enqueueConverted(ptr, frames, inputChannelNum) : enqueue(ptr, currentSize);
+    }
+    else if constexpr (std::same_as<T, float>)
+    {
+        const auto data = needChannelConversion ? channelConversion(ptr, frames, inputChannelNum).data() : ptr;
+        written = enqueueResampled(data, frames, inputSampleRate);
     }
     else
     {
-        if (delayTime > outputDelay.load())
-            outputDelay.store(delayTime);
+        // libsamplerate only works in float : the input is widened once here, mapped to the queue layout in float,
+        // and only quantized again on its way into the ring. Resampled 32 bit and double queues are limited to float resolution.
+        // Before a channel mapping the widened input sits in resampleStaging, which is free until the converter writes to it.
+        auto& wide = needChannelConversion ? resampleStaging : resampleInput;
+        bufferGrow(wide, currentSize);
+        samplesToFloat(ptr, wide.data(), currentSize);
+        written = enqueueMapped(wide.data(), frames, inputChannelNum, inputSampleRate);
     }
 
-    for (const auto i : temp)
+    return pushFinish(frames, written);
+}
+
+/**
+ * @brief Float input into a non float queue, converted to the queue format exactly once.
+ * 
+ * Input at the queue rate is converted first and pushed as any other input. Input that needs resampling
+ * goes through the float converter as it is and is only converted on its way into the ring.
+ */
+template<audioType T>
+bool audioQueue<T>::push(const         float* ptr, 
+                         const std::  size_t  frames, 
+                         const std:: uint8_t  inputChannelNum, 
+                         const std::uint32_t  inputSampleRate) requires (!std::same_as<T, float>)
+{
+    if (inputSampleRate == audioSampleRate && !driftCompensation)
     {
-        if (!this->enqueue(i))
-        {
-            std::print(stderr,"push aborted, no enough space.\n");
-            usageRefresh();
-            return false;
-        }
+        const auto count = frames * inputChannelNum;
+        bufferGrow(inputBuffer, count);
+        samplesFromFloat(ptr, inputBuffer.data(), count);
+        return push(inputBuffer.data(), frames, inputChannelNum, inputSampleRate);
     }
-    usageRefresh();
-    return true;
+
+    driftRefresh();
+    return pushFinish(frames, enqueueMapped(ptr, frames, inputChannelNum, inputSampleRate));
 }
 
 template<audioType T>
@@ -264,36 +896,194 @@ bool audioQueue<T>::pop(                 T* &ptr,
                          const bool          mode)
 {
     const auto size = frames * channelNum;
-    const auto estimatedUsage = usage.load() >= (size * 100 / queue.size()) ? usage.load() - (size * 100 / queue.size()) : 0;
-    queueBlocker inputBlocker(0.1, 0.01, 0.01, 50);
-    const auto delayCoefficient = 4 / queueCount;
-    auto delayTime = static_cast<int>(delayCoefficient * inputBlocker.delayCalculate(estimatedUsage));
-    if (delayTime < 0)  outputDelay.store(-delayTime);
-    else                outputDelay.store( delayTime); 
-
-    for (auto i = 0; i < size; i++)
-    {   
-        if (!this->dequeue(ptr[i],mode)) 
+    const auto done = mode ? mixInto(ptr, frames) * channelNum : dequeue(ptr, size, false);
+    // Called from the audio callback : an underrun is only counted, reporting is left to a non real time thread.
+    // The mixing path already counts its own underruns in mixInto.
+    if (done < size && !mode) 
+        underrunCount.fetch_add(1, std::memory_order_relaxed);
+    minFillRefresh();
+    return done == size;
+}
+
+/**
+ * @brief Accumulate up to frames frames into out with the source gain, pan and mute, in one vectorized pass per ring span.
+ * 
+ * gain is an extra multiplier on top of the source controls. A control change is ramped linearly across
+ * the frames of this call to avoid zipper noise. Returns the number of frames actually mixed, an underrun
+ * leaves the rest of out untouched and is counted in underrunCount. Wait free, safe to call from the audio callback.
+ * With a latency target nothing is mixed until the queue holds that many frames, and excess frames are dropped.
+ * out is either in the queue format, or a float bus for any other format : the samples are then converted
+ * to float, scaled and accumulated in the same pass.
+ */
+template<audioType T>
+template<typename O>
+std::size_t audioQueue<T>::mixBus(      O*          out, 
+                                  const std::size_t frames,
+                                  const float       gain)
+{
+    if (channelNum == 0 || frames == 0) return 0;
+    if (!jitterGate(frames))            return 0;
+
+    const auto  count  = frames * channelNum;
+    const auto  target = targetGain(gain);
+    std::size_t mixed  = 0;
+
+    if (target == appliedGain && target[0] == target[1])
+    {
+        // Steady state with one gain for every channel, a muted source is consumed without touching out.
+        if (target[0] == 0.0f)
+            mixed = consume(count, [](const std::size_t, const T*, const std::size_t) {});
+        else
+            mixed = consume(count, [out, level = target[0]](const std::size_t offset, const T* src, const std::size_t n) 
+            { 
+                if constexpr (std::same_as<O, T>)
+                    mixScaled (out + offset, src, n, level);
+                else
+                    mixToFloat(out + offset, src, n, level);
+            });
+    }
+    else
+    {
+        std::array<float, 256> gains;
+        std::array<float, 256> steps;
+        for (std::uint8_t c = 0; c < channelNum; c++)
         {
-           std::print(stderr,"pop aborted, no enough element in queue.\n");
-           usageRefresh();
-           return false;
+            const auto side = channelNum == 2 ? c : 0;
+            gains[c] = appliedGain[side];
+            steps[c] = (target[side] - appliedGain[side]) / frames;
         }
+        mixed = consume(count, [&](const std::size_t offset, const T* src, const std::size_t n) 
+        { 
+            const auto phase = static_cast<std::uint8_t>(offset % channelNum);
+            if constexpr (std::same_as<O, T>)
+                mixRamp       (out + offset, src, n, channelNum, phase, gains.data(), steps.data());
+            else
+                mixRampToFloat(out + offset, src, n, channelNum, phase, gains.data(), steps.data());
+        });
+
+        const auto mixedFrames = mixed / channelNum;
+        for (std::size_t side = 0; side < appliedGain.size(); side++)
+            appliedGain[side] = mixedFrames == frames ? target[side] : appliedGain[side] + (target[side] - appliedGain[side]) * mixedFrames / frames;
     }
-    usageRefresh();
-    return true;
+    if (mixed < count)
+    {
+        // The missing frames stay silent, a jitter buffer then waits for its target again before playing.
+        underrunCount.fetch_add(1, std::memory_order_relaxed);
+        if (targetLatency.load(std::memory_order_relaxed) != 0)
+            prefilling.store(true, std::memory_order_relaxed);
+    }
+    minFillRefresh();
+    return mixed / channelNum;
+}
+
+/**
+ * @brief Reserve room for frames in the queue format and hand it to the producer.
+ * 
+ * The region is empty if the queue cannot hold all frames. Data written into it becomes
+ * visible to the consumer only after commitWrite, which must not exceed the reserved frames.
+ */
+template<audioType T>
+typename audioQueue<T>::writeRegion audioQueue<T>::reserveWrite(const std::size_t frames)
+{
+    return reserveSamples(frames * channelNum);
+}
+
+template<audioType T>
+void audioQueue<T>::commitWrite(const std::size_t frames)
+{
+    const auto count = frames * channelNum;
+    if (frames > burstFrames.load(std::memory_order_relaxed))
+        burstFrames.store(frames, std::memory_order_relaxed);
+    tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    maxFillRefresh();
 }
 
+/**
+ * @brief Drop everything buffered so far and restart the resampler, for a producer that jumps in its stream.
+ * 
+ * Producer side. The consumer skips the dropped samples on its next read, data pushed afterwards plays normally.
+ */
+template<audioType T>
+void audioQueue<T>::flush()
+{
+    resetResampler();
+    flushMark.store(tail.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+/**
+ * @brief Turn the queue into a jitter buffer holding about frames frames of latency, 0 turns it off.
+ * 
+ * Playback restarts from a prefill, drift compensation follows the new target.
+ */
+template<audioType T>
+void audioQueue<T>::setTargetLatency(const std::size_t frames) noexcept
+{
+    targetLatency.store(frames, std::memory_order_relaxed);
+    prefilling   .store(frames != 0, std::memory_order_relaxed);
+}
+
+template<audioType T>
+typename audioQueue<T>::queueStatistics audioQueue<T>::statistics(const bool reset) noexcept
+{
+    queueStatistics stats;
+    stats.fill          = channelNum == 0 ? 0 : size() / channelNum;
+    stats.minFill       = reset ? minFill.exchange(std::numeric_limits<std::size_t>::max(), std::memory_order_relaxed) : minFill.load(std::memory_order_relaxed);
+    stats.maxFill       = reset ? maxFill.exchange(0, std::memory_order_relaxed) : maxFill.load(std::memory_order_relaxed);
+    stats.targetLatency = targetLatency.load(std::memory_order_relaxed);
+    stats.underruns     = underrunCount.load(std::memory_order_relaxed);
+    stats.overruns      = overrunCount .load(std::memory_order_relaxed) + dropCount.load(std::memory_order_relaxed);
+    if (stats.minFill > stats.maxFill) stats.minFill = stats.fill; // Nothing recorded since the last reset
+    return stats;
+}
+
+/**
+ * @brief Resize the ring to newCapacity samples, rounded up to a power of two.
+ * 
+ * Growing keeps every buffered sample and is safe while the consumer keeps reading : the samples are copied
+ * to a new storage at the same free running indices, which is then published and the old one retired.
+ * Shrinking starts from an empty ring and must not race with the consumer.
+ * growCapacity only ever grows, at least doubling, so a producer can call it for every block.
+ */
 template<audioType T>
 inline void audioQueue<T>::setCapacity(const std::size_t newCapacity) 
 {   
-    if (newCapacity == queue.size()) return;
+    const auto  roundedCapacity = roundCapacity(newCapacity);
+    const auto &current         = *ring.load(std::memory_order_relaxed);
+    if (roundedCapacity == current.size) return;
+
+    auto next = roundedCapacity == 0 ? nullptr : std::make_unique<ringStorage>(roundedCapacity);
+    if (next) allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (roundedCapacity > current.size)
+    {
+        // Only this thread moves tail, the consumer only moves head forward, so [head, tail) stays valid during the copy.
+        const auto last = tail.load(std::memory_order_relaxed);
+        for (auto index = head.load(std::memory_order_acquire); index != last; )
+        {
+            const auto from  = index & current.mask;
+            const auto to    = index & next->mask;
+            const auto count = std::min({ last - index, current.size - from, next->size - to });
+            std::copy_n(current.data.get() + from, count, next->data.get() + to);
+            index += count;
+        }
+        storageSwap(std::move(next));
+    }
     else
     {
-        if (!this->empty()) this->clear();
-        queue.resize(newCapacity);
+        // Free running indices are only meaningful for one mask, so a shrink starts from an empty ring.
+        storageSwap(std::move(next));
+        this->clear();
     }
 }
 #pragma endregion
 
+/**
+ * @brief Queue format of the mixer inputs. Producers push float and the output mix converts to its float bus,
+ * so a memory bound build can define AUDIO_MIX_SAMPLE as short (or int24) to shrink every ring without touching a producer.
+ */
+#ifndef AUDIO_MIX_SAMPLE
+#define AUDIO_MIX_SAMPLE float
+#endif
+using mixSample = AUDIO_MIX_SAMPLE;
+using mixQueue  = audioQueue<mixSample>;
+
 #endif// AUDIO_QUEUE_H
\ No newline at end of file
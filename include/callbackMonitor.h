@@ -0,0 +1,211 @@
+#ifndef CALLBACK_MONITOR_H
+#define CALLBACK_MONITOR_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Lock free log linear histogram of durations in nanoseconds, in the manner of HDR histograms.
+ *
+ * Values below 16 ns have a bucket each, above that every power of two is split in 16 buckets, so a recorded
+ * value is known within 1/16 (6.25%) up to about 36 minutes. record is one relaxed increment plus a maximum
+ * update, wait free in practice and safe in the audio callback. Readers see counts that may be a few records apart.
+ */
+class latencyHistogram
+{
+    private :
+    static constexpr std::uint32_t                      subBits     = 4;
+    static constexpr std::uint32_t                      subBuckets  = 1u << subBits;
+    static constexpr std::uint32_t                      maxExponent = 40;
+    static constexpr std::size_t                        bucketNum   = (maxExponent - subBits + 2) * subBuckets;
+
+                std::array<std::atomic<std::uint64_t>, bucketNum>  buckets;
+                                    std::atomic<std::uint64_t>  total;
+                                    std::atomic<std::uint64_t>  maximum;
+                                    std::atomic<std::uint64_t>  sum;
+
+    public :
+  /*inline    Return Type    Function            const  Argument Type    Argument               const  noexcept      Implementation*/
+
+                             latencyHistogram   ()                                                                  : buckets{}, total(0), maximum(0), sum(0) {}
+                             latencyHistogram   (const latencyHistogram  &other)                                    = delete;
+
+                       void  record             (const  std::uint64_t    nanoseconds)                  noexcept;
+    inline    std::uint64_t  count              ()                                              const  noexcept     { return total.load(std::memory_order_relaxed); }
+    inline    std::uint64_t  max                ()                                              const  noexcept     { return maximum.load(std::memory_order_relaxed); }
+    inline           double  mean               ()                                              const  noexcept     { const auto n = count(); return n == 0 ? 0.0 : static_cast<double>(sum.load(std::memory_order_relaxed)) / n; }
+              std::uint64_t  percentile         (const         double    fraction)              const  noexcept;
+
+    private :
+    static     std::  size_t  bucketOf          (const  std::uint64_t    nanoseconds)                  noexcept;
+    static     std::uint64_t  bucketTop         (const  std::  size_t    bucket)                       noexcept;
+};
+
+/**
+ * @brief Timing and status counters of an output callback, written by the callback and read by a monitoring thread.
+ *
+ * The callback brackets its work with begin and end, which record the execution time against the buffer period
+ * and count the device status flags. Everything is a relaxed atomic, so reading or dumping never blocks the callback.
+ * Queue underruns are counted by the queues themselves, the monitoring thread hands their sum in with setQueueUnderruns.
+ */
+class callbackMonitor
+{
+    private :
+                                            latencyHistogram    executionTime;
+                                    std::atomic<std::uint64_t>  callbacks;
+                                    std::atomic<std::uint64_t>  overruns;
+                                    std::atomic<std::uint64_t>  lateFrames;
+                                    std::atomic<std::uint64_t>  outputUnderflows;
+                                    std::atomic<std::uint64_t>  outputOverflows;
+                                    std::atomic<std::uint64_t>  primingOutputs;
+                                    std::atomic<std::uint64_t>  queueUnderruns;
+                                                std::uint32_t   sampleRate;
+
+    public :
+    using clock = std::chrono::steady_clock;
+
+    // Device status, the bit values are those of PortAudio so its callback flags pass through unchanged.
+    static constexpr unsigned long outputUnderflow = 0x04;
+    static constexpr unsigned long outputOverflow  = 0x08;
+    static constexpr unsigned long primingOutput   = 0x10;
+
+  /*inline    Return Type    Function            const  Argument Type    Argument               const  noexcept      Implementation*/
+
+    explicit                 callbackMonitor    (const  std::uint32_t    sampleRate)                                : callbacks(0), overruns(0), lateFrames(0), outputUnderflows(0), outputOverflows(0), primingOutputs(0), queueUnderruns(0), sampleRate(sampleRate) {}
+                             callbackMonitor    (const callbackMonitor   &other)                                    = delete;
+
+    inline clock::time_point  begin             ()                                              const  noexcept     { return clock::now(); }
+                       void  end                (const clock::time_point start,
+                                                 const  std::  size_t    frames,
+                                                 const  unsigned long    statusFlags)                  noexcept;
+    inline             void  setQueueUnderruns  (const  std::uint64_t    count)                        noexcept     { queueUnderruns.store(count, std::memory_order_relaxed); }
+
+    inline const latencyHistogram& histogram    ()                                              const  noexcept     { return executionTime; }
+    inline    std::uint64_t  getOverrunCount    ()                                              const  noexcept     { return overruns.load(std::memory_order_relaxed); }
+    inline    std::uint64_t  getUnderflowCount  ()                                              const  noexcept     { return outputUnderflows.load(std::memory_order_relaxed); }
+                std::string  toJson             ()                                              const;
+                std::string  toPrometheus       ()                                              const;
+};
+
+#pragma region Latency histogram
+inline std::size_t latencyHistogram::bucketOf(const std::uint64_t nanoseconds) noexcept
+{
+    if (nanoseconds < subBuckets) return static_cast<std::size_t>(nanoseconds);
+    const auto value    = std::min<std::uint64_t>(nanoseconds, (std::uint64_t(1) << (maxExponent + 1)) - 1);
+    const auto exponent = static_cast<std::uint32_t>(std::bit_width(value)) - 1;
+    const auto sub      = (value >> (exponent - subBits)) & (subBuckets - 1);
+    return (exponent - subBits + 1) * subBuckets + static_cast<std::size_t>(sub);
+}
+
+/**
+ * @brief Highest value that falls into bucket.
+ */
+inline std::uint64_t latencyHistogram::bucketTop(const std::size_t bucket) noexcept
+{
+    if (bucket < subBuckets) return bucket;
+    const auto exponent = static_cast<std::uint32_t>(bucket / subBuckets) + subBits - 1;
+    const auto sub      = static_cast<std::uint64_t>(bucket % subBuckets);
+    const auto width    = std::uint64_t(1) << (exponent - subBits);
+    return ((subBuckets + sub) << (exponent - subBits)) + width - 1;
+}
+
+inline void latencyHistogram::record(const std::uint64_t nanoseconds) noexcept
+{
+    buckets[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    sum  .fetch_add(nanoseconds, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+
+    auto current = maximum.load(std::memory_order_relaxed);
+    while (nanoseconds > current && !maximum.compare_exchange_weak(current, nanoseconds, std::memory_order_relaxed)) {}
+}
+
+/**
+ * @brief Value below which fraction of the records fall, as the top of its bucket, 0 while empty.
+ */
+inline std::uint64_t latencyHistogram::percentile(const double fraction) const noexcept
+{
+    const auto records = count();
+    if (records == 0) return 0;
+
+    const auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::clamp(fraction, 0.0, 1.0) * records + 0.5));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < bucketNum; i++)
+    {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) return std::min(bucketTop(i), max());
+    }
+    return max();
+}
+#pragma endregion
+
+#pragma region Callback monitor
+/**
+ * @brief Record one callback that started at start and rendered frames frames. Wait free.
+ *
+ * A callback that took longer than its buffer lasts is an overrun, its frames are counted as late.
+ */
+inline void callbackMonitor::end(const clock::time_point start,
+                                 const std::  size_t     frames,
+                                 const unsigned long     statusFlags) noexcept
+{
+    const auto elapsed = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+    const auto period  = sampleRate == 0 ? 0 : frames * 1000000000ull / sampleRate;
+    executionTime.record(elapsed);
+    callbacks.fetch_add(1, std::memory_order_relaxed);
+    if (elapsed > period)
+    {
+        overruns  .fetch_add(1,      std::memory_order_relaxed);
+        lateFrames.fetch_add(frames, std::memory_order_relaxed);
+    }
+    if (statusFlags & outputUnderflow) outputUnderflows.fetch_add(1, std::memory_order_relaxed);
+    if (statusFlags & outputOverflow)  outputOverflows .fetch_add(1, std::memory_order_relaxed);
+    if (statusFlags & primingOutput)   primingOutputs  .fetch_add(1, std::memory_order_relaxed);
+}
+
+inline std::string callbackMonitor::toJson() const
+{
+    const auto& h = executionTime;
+    return std::format("{{\"callbacks\":{},\"overruns\":{},\"late_frames\":{},\"output_underflows\":{},\"output_overflows\":{},"
+                       "\"priming_outputs\":{},\"queue_underruns\":{},\"execution_ns\":{{\"mean\":{:.0f},\"p50\":{},\"p90\":{},"
+                       "\"p99\":{},\"p999\":{},\"max\":{}}}}}",
+                       callbacks.load(std::memory_order_relaxed), overruns.load(std::memory_order_relaxed), lateFrames.load(std::memory_order_relaxed),
+                       outputUnderflows.load(std::memory_order_relaxed), outputOverflows.load(std::memory_order_relaxed),
+                       primingOutputs.load(std::memory_order_relaxed), queueUnderruns.load(std::memory_order_relaxed),
+                       h.mean(), h.percentile(0.5), h.percentile(0.9), h.percentile(0.99), h.percentile(0.999), h.max());
+}
+
+/**
+ * @brief Prometheus text exposition : counters, and the execution time as a summary in seconds.
+ */
+inline std::string callbackMonitor::toPrometheus() const
+{
+    const auto& h = executionTime;
+    std::string text;
+    const auto counter = [&text](std::string_view name, std::string_view help, std::uint64_t value)
+    {
+        text += std::format("# HELP audiomixer_{0} {1}\n# TYPE audiomixer_{0} counter\naudiomixer_{0} {2}\n", name, help, value);
+    };
+    counter("callbacks_total",         "Output callbacks run.",                                    callbacks.load(std::memory_order_relaxed));
+    counter("callback_overruns_total", "Callbacks that took longer than their buffer period.",     overruns.load(std::memory_order_relaxed));
+    counter("late_frames_total",       "Frames rendered by overrunning callbacks.",                lateFrames.load(std::memory_order_relaxed));
+    counter("output_underflows_total", "Buffers the output device reported as underflowed.",       outputUnderflows.load(std::memory_order_relaxed));
+    counter("output_overflows_total",  "Buffers the output device reported as overflowed.",        outputOverflows.load(std::memory_order_relaxed));
+    counter("priming_outputs_total",   "Buffers rendered while the output device was priming.",    primingOutputs.load(std::memory_order_relaxed));
+    counter("queue_underruns_total",   "Mixes that found an input queue short of frames.",         queueUnderruns.load(std::memory_order_relaxed));
+
+    text += "# HELP audiomixer_callback_seconds Output callback execution time.\n# TYPE audiomixer_callback_seconds summary\n";
+    for (const auto quantile : { 0.5, 0.9, 0.99, 0.999 })
+        text += std::format("audiomixer_callback_seconds{{quantile=\"{}\"}} {:.9f}\n", quantile, h.percentile(quantile) / 1e9);
+    text += std::format("audiomixer_callback_seconds_sum {:.9f}\naudiomixer_callback_seconds_count {}\n", h.mean() * h.count() / 1e9, h.count());
+    return text;
+}
+#pragma endregion
+
+#endif// CALLBACK_MONITOR_H
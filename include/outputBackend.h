@@ -0,0 +1,131 @@
+#ifndef OUTPUT_BACKEND_H
+#define OUTPUT_BACKEND_H
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "portaudio.h"
+#include "sndfile.hh"
+
+/**
+ * @brief Where the mix goes : the default PortAudio device, nowhere on a timer, or a sound file on a timer.
+ */
+enum class outputBackendType
+{
+	portAudio,
+	null,
+	file
+};
+
+/**
+ * @brief Output stream settings shared by every backend. filePath is only used by the file backend.
+ */
+struct outputSettings
+{
+	std::uint32_t			sampleRate	 = 48000;
+	std::uint8_t			channels	 = 2;
+	std::size_t				bufferFrames = 512;
+	std::filesystem::path	filePath;
+};
+
+/**
+ * @brief Output device that periodically asks render for bufferFrames interleaved float frames.
+ *
+ * render is called from the backend thread with the same real time rules as a PortAudio callback,
+ * and gets the PortAudio status flags of the buffer whatever the backend.
+ * start and stop may be called repeatedly, a stopped backend keeps its device open.
+ */
+class outputBackend
+{
+	public :
+		using renderFunction = void(*)(float* out, std::size_t frames, PaStreamCallbackFlags statusFlags, void* userData);
+	protected :
+		outputSettings	settings;
+		renderFunction	render;
+		void*			userData;
+
+						outputBackend	(const outputSettings& settings, renderFunction render, void* userData)
+							: settings(settings), render(render), userData(userData) {}
+	public :
+						outputBackend	(const outputBackend& other) = delete;
+		virtual			~outputBackend	() = default;
+
+		virtual bool	isOpen			() const = 0;
+		virtual bool	start			() = 0;
+		virtual void	stop			() = 0;
+		virtual std::uint64_t missedDeadlines() const { return 0; }
+};
+
+/**
+ * @brief Default PortAudio output device, render runs in the PortAudio callback.
+ */
+class portAudioBackend : public outputBackend
+{
+	private :
+		PaStream*		stream;
+		bool			initialized;
+
+		static int		callback		(const	void*						inputBuffer,
+												void*						outputBuffer,
+												unsigned long				framesPerBuffer,
+										 const	PaStreamCallbackTimeInfo*	timeInfo,
+												PaStreamCallbackFlags		statusFlags,
+												void*						self);
+	public :
+						portAudioBackend(const outputSettings& settings, renderFunction render, void* userData);
+						~portAudioBackend() override;
+
+		bool			isOpen			() const override { return stream != nullptr; }
+		bool			start			() override;
+		void			stop			() override;
+};
+
+/**
+ * @brief Backend without hardware : a thread renders one buffer per period against an absolute monotonic deadline.
+ *
+ * The deadline advances by exactly one period each time, so the stream does not drift however long render takes.
+ * A render that ends past the next deadline counts as a missed deadline and the schedule restarts from now,
+ * like a device dropping a buffer, the next render is then flagged paOutputUnderflow. Rendered buffers are discarded, deliver lets a derived backend keep them.
+ */
+class nullBackend : public outputBackend
+{
+	private :
+		std::vector<float>			buffer;
+		std::atomic<std::uint64_t>	missed;
+		std::jthread				clock;
+
+				void	clockLoop		(std::stop_token stop);
+	protected :
+		virtual void	deliver			(const float* /*buffer*/, std::size_t /*frames*/) {}
+	public :
+						nullBackend		(const outputSettings& settings, renderFunction render, void* userData);
+						~nullBackend	() override { stop(); }
+
+		bool			isOpen			() const override { return true; }
+		bool			start			() override;
+		void			stop			() override;
+		std::uint64_t	missedDeadlines	() const override { return missed.load(std::memory_order_relaxed); }
+};
+
+/**
+ * @brief Null backend that also writes every rendered buffer to a float WAV file, or 24 bit FLAC for a .flac path.
+ */
+class fileBackend : public nullBackend
+{
+	private :
+		SndfileHandle	file;
+
+		void			deliver			(const float* buffer, std::size_t frames) override;
+	public :
+						fileBackend		(const outputSettings& settings, renderFunction render, void* userData);
+						~fileBackend	() override { stop(); }
+
+		bool			isOpen			() const override { return !file.error(); }
+};
+
+std::unique_ptr<outputBackend> outputBackendCreate(outputBackendType type, const outputSettings& settings, outputBackend::renderFunction render, void* userData);
+
+#endif// OUTPUT_BACKEND_H
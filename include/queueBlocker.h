@@ -1,8 +1,14 @@
 #ifndef QUEUE_BLOCKER_H
-#define QUEUE_BLCCKER_H
+#define QUEUE_BLOCKER_H
 
 #include <chrono>
 
+/**
+ * @brief PID controller on the fill level of a queue.
+ * 
+ * delayCalculate gives the raw controller output. ratioCalculate clamps it to a small
+ * correction around 1, used to nudge a resampling ratio instead of sleeping a thread.
+ */
 class queueBlocker
 {
 	private :
@@ -14,16 +20,22 @@ class queueBlocker
 		double derivative;
 		double target;
 		double delay;
+		double limit;
 	public :
 					 queueBlocker	();
 					 queueBlocker	(double Kp,
 									 double Ki,
 									 double Kd,
-									 double target);
+									 double target,
+									 double limit = 0.005);
 			  void	setParameters	(double newKp,
 									 double newKi,
 									 double newKd)		{ Kp = newKp; Ki = newKi;Kd = newKd; }
+			  void	setTarget		(double newTarget)	{ target = newTarget; }
+			  void	setLimit		(double newLimit)	{ limit = newLimit; }
+			  void	reset			()					{ prevErr = 0; integral = 0; derivative = 0; }
 			double	delayCalculate	(double value);
+			double	ratioCalculate	(double value);
 };
 
-#endif // QUEUE_BLOCKER_H
\ No newline at end of file
+#endif // QUEUE_BLOCKER_H
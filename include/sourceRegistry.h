@@ -0,0 +1,134 @@
+#ifndef SOURCE_REGISTRY_H
+#define SOURCE_REGISTRY_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Set of input sources that can be added and removed while the output callback keeps reading it.
+ *
+ * Readers see an immutable snapshot of source pointers, swapped as a whole by add and remove (read copy update).
+ * A reader only touches two atomics and never waits, so forEach is safe in the audio callback.
+ * Writers are serialized by a mutex, publish the new snapshot, then wait until the readers that may still
+ * hold the old one are gone before freeing it and any removed source. Readers are counted in two phases :
+ * a writer flips the phase and drains the old one twice, so both counters are seen at zero after the publication,
+ * including the one of a reader that read the phase before a flip but only counted itself after it.
+ * Readers arriving after a flip enter the phase not being drained, so a steady stream of them cannot hold a writer back.
+ */
+template<typename S>
+class sourceRegistry
+{
+    private :
+    struct snapshot
+    {
+        std::vector<S*> sources;
+    };
+
+                                    std::unique_ptr<snapshot>           current;
+                                            std::atomic<snapshot*>      published;
+                         mutable std::array<std::atomic<std::uint32_t>, 2>  activeReaders;
+                                            std::atomic<std::uint32_t>  readerPhase;
+                                            std::vector<std::unique_ptr<S>> owned;
+                                                        std::mutex      writerLock;
+
+    public :
+  /*inline    Return Type    Function            const  Argument Type    Argument               const  noexcept      Implementation*/
+
+                             sourceRegistry     ()                                                                  : current(std::make_unique<snapshot>()), published(current.get()), activeReaders{}, readerPhase(0) {}
+                             sourceRegistry     (const sourceRegistry<S>  &other)                                   = delete;
+           sourceRegistry&   operator=          (const sourceRegistry<S>  &other)                                   = delete;
+
+                         S*  add                (std::unique_ptr<S>      source);
+                       bool  remove             (const              S*   source);
+    template<typename F>
+                       void  forEach            (                   F  &&function)                  const  noexcept;
+                std::size_t  size               ()                                              const  noexcept;
+
+    private :
+                       void  publish            (std::unique_ptr<snapshot>  next);
+};
+
+/**
+ * @brief Take ownership of source and make it visible to readers, returns it for the producer side to feed.
+ */
+template<typename S>
+S* sourceRegistry<S>::add(std::unique_ptr<S> source)
+{
+    std::lock_guard lock(writerLock);
+    auto* added = source.get();
+    auto  next  = std::make_unique<snapshot>(*current);
+    next->sources.push_back(added);
+    owned.push_back(std::move(source));
+    publish(std::move(next));
+    return added;
+}
+
+/**
+ * @brief Hide source from readers and destroy it once no reader can still hold it.
+ *
+ * Its producer must have stopped using it before. Returns false if the source is not registered.
+ */
+template<typename S>
+bool sourceRegistry<S>::remove(const S* source)
+{
+    std::lock_guard lock(writerLock);
+    const auto found = std::ranges::find_if(owned, [source](const std::unique_ptr<S> &i) { return i.get() == source; });
+    if (found == owned.end()) return false;
+
+    auto next = std::make_unique<snapshot>(*current);
+    std::erase(next->sources, source);
+    publish(std::move(next));
+
+    // No reader sees the source any more, it can go.
+    owned.erase(found);
+    return true;
+}
+
+/**
+ * @brief Call function on every source of the current snapshot. Wait free.
+ */
+template<typename S>
+template<typename F>
+void sourceRegistry<S>::forEach(F &&function) const noexcept
+{
+    // Announcing the reader before loading the snapshot lets a writer that published after this point wait for it.
+    const auto  phase = readerPhase.load(std::memory_order_acquire) & 1;
+    activeReaders[phase].fetch_add(1, std::memory_order_seq_cst);
+    const auto* view  = published.load(std::memory_order_seq_cst);
+    for (auto* i : view->sources)
+        function(*i);
+    activeReaders[phase].fetch_sub(1, std::memory_order_release);
+}
+
+template<typename S>
+std::size_t sourceRegistry<S>::size() const noexcept
+{
+    std::size_t count = 0;
+    forEach([&count](const S&) { count++; });
+    return count;
+}
+
+template<typename S>
+void sourceRegistry<S>::publish(std::unique_ptr<snapshot> next)
+{
+    auto retired = std::exchange(current, std::move(next));
+    published.store(current.get(), std::memory_order_seq_cst);
+
+    // A reader counted in a phase after it was seen drained loads the snapshot after the publication, so it sees the new one.
+    // One flip is not enough : a reader may have read the phase before the flip and count itself in the drained phase later.
+    for (auto flip = 0; flip < 2; flip++)
+    {
+        const auto phase = readerPhase.fetch_add(1, std::memory_order_seq_cst) & 1;
+        while (activeReaders[phase].load(std::memory_order_seq_cst) != 0) std::this_thread::yield();
+    }
+}
+
+#endif// SOURCE_REGISTRY_H
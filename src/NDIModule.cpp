@@ -2,30 +2,161 @@
 #include "Processing.NDI.Lib.h"
 #include <iostream>
 #include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <thread>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#endif
 
 
 constexpr auto NDI_TIMEOUT = 1000;
+constexpr auto NDI_CAPTURE_TIMEOUT = 100; // A worker with a single source blocks this long (ms) waiting for a frame
 constexpr auto QUEUE_SIZE_MULTIPLIER = 2;
+constexpr auto NDI_IDLE_BACKOFF = std::chrono::milliseconds(1);
+constexpr auto NDI_TARGET_LATENCY = 20; // Jitter buffer depth in ms
 
+/**
+ * @brief Report a failed NDI call and hand the pointer back, the caller gives up on its own work instead of ending the process.
+ */
 template <typename T>
 inline T* NDIErrorCheck(T* ptr) 
 { 
 	if (!ptr) 
-	{ 
 		std::print(stderr,"NDI Error: No source is found.\n"); 
-		exit(EXIT_FAILURE); 
-	}
-	else return ptr; 
+	return ptr; 
 } 
 
-void NDIAudioReceive(std::vector<audioQueue<float>> &queueList, int PA_SAMPLE_RATE, int PA_OUTPUT_CHANNELS)
+static std::atomic<std::uint64_t> NDIAllocations(0);
+
+/**
+ * @brief Interleaving buffer owned by one capture worker.
+ * 
+ * It only grows, to the next power of two, when a frame is larger than every frame before, 
+ * so the receive path stops allocating once the largest frame size has been seen.
+ */
+class NDIScratchBuffer
 {
-	NDIlib_initialize();
+public:
+	float* acquire(std::size_t size)
+	{
+		if (size > buffer.size())
+		{
+			buffer.resize(std::bit_ceil(size));
+			NDIAllocations.fetch_add(1, std::memory_order_relaxed);
+		}
+		return buffer.data();
+	}
+private:
+	std::vector<float> buffer;
+};
 
-	std::size_t speedCounter = 0;
+std::uint64_t NDIAllocationCount()
+{
+	return NDIAllocations.load(std::memory_order_relaxed);
+}
 
-	const NDIlib_find_create_t NDIFindCreateDesc;
-	auto pNDIFind = NDIErrorCheck(NDIlib_find_create_v2(&NDIFindCreateDesc));
+/**
+ * @brief Convert one captured NDI audio frame to interleaved float and queue it.
+ * A float queue of the same format takes the conversion in place, other queues quantize on push.
+ */
+template<typename T>
+static void NDIAudioFrameProcess(const NDIlib_audio_frame_v2_t &audioInput, audioQueue<T> &queue, NDIScratchBuffer &scratch, std::size_t latencyFrames)
+{
+	const auto dataSize			= static_cast<size_t>(audioInput.no_samples) * audioInput.no_channels;
+	const auto queueAllocations = queue.getAllocationCount();
+	// The ring holds the queue's channels at the output rate : an upsampled frame takes up to ceil(output / input) times its length.
+	const auto inputRate		= static_cast<std::size_t>(std::max(audioInput.sample_rate, 1));
+	const auto rateFactor		= (queue.sampleRate() + inputRate - 1) / inputRate;
+	const auto queuedSize		= static_cast<std::size_t>(audioInput.no_samples) * queue.channels() * rateFactor;
+	// Only grows, keeping buffered audio, so a change of NDI frame size neither drops samples nor disturbs the callback.
+	queue.growCapacity((queuedSize + latencyFrames * queue.channels()) * QUEUE_SIZE_MULTIPLIER);
+
+	NDIlib_audio_frame_interleaved_32f_t audioDataNDI;
+	bool written = false;
+	if constexpr (std::same_as<T, float>)
+	{
+		const bool sameFormat = audioInput.no_channels == queue.channels() && 
+								audioInput.sample_rate == static_cast<int>(queue.sampleRate()) &&
+								!queue.isDriftCompensated();
+		const auto region	  = sameFormat ? queue.reserveWrite(audioInput.no_samples) : typename audioQueue<T>::writeRegion{};
+		if (region.second.empty() && region.first.size() == dataSize && dataSize != 0)
+		{
+			// Same format and no wrap around : convert to interleaved float straight into the queue.
+			audioDataNDI.p_data = region.first.data();
+			NDIlib_util_audio_to_interleaved_32f_v2(&audioInput, &audioDataNDI);
+			queue.commitWrite(audioInput.no_samples);
+			written = true;
+		}
+	}
+	if (!written)
+	{
+		// Convert to interleaved float in the worker's scratch buffer, the queue resamples, maps channels and quantizes on push.
+		audioDataNDI.p_data = scratch.acquire(dataSize);
+		NDIlib_util_audio_to_interleaved_32f_v2(&audioInput, &audioDataNDI);
+		queue.push(audioDataNDI.p_data, audioDataNDI.no_samples, audioDataNDI.no_channels, audioDataNDI.sample_rate);
+	}
+	// Ring growth, converter creation and work buffers of the queue all happen on this thread too.
+	NDIAllocations.fetch_add(queue.getAllocationCount() - queueAllocations, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Pin a capture worker to one core, does nothing on platforms without an affinity API.
+ */
+static void NDIWorkerPin(std::jthread &worker, std::size_t core)
+{
+#ifdef _WIN32
+	SetThreadAffinityMask(worker.native_handle(), static_cast<DWORD_PTR>(1) << (core % (sizeof(DWORD_PTR) * 8)));
+#elif defined(__linux__)
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	CPU_SET(core % CPU_SETSIZE, &cpuSet);
+	pthread_setaffinity_np(worker.native_handle(), sizeof(cpuSet), &cpuSet);
+#endif
+}
+
+/**
+ * @brief Capture loop of one worker, serving the sources whose index is in sources.
+ * 
+ * A worker owning a single source blocks inside the NDI capture call, so it wakes as soon as a frame arrives.
+ * A worker sharing several sources polls them without timeout and only backs off when all of them were idle.
+ */
+static void NDICaptureWorker(std::stop_token stop,
+							 std::vector<std::size_t> sources,
+							 const std::vector<NDIlib_recv_instance_t> &recvList,
+							 const std::vector<mixQueue*> &queueList,
+							 std::size_t latencyFrames)
+{
+	const auto timeout = sources.size() == 1 ? NDI_CAPTURE_TIMEOUT : 0;
+	NDIScratchBuffer scratch;
+	while (!stop.stop_requested())
+	{
+		bool received = false;
+		bool waited   = timeout != 0;
+		for (const auto i : sources)
+		{
+			NDIlib_audio_frame_v2_t audioInput;
+			const auto type = NDIlib_recv_capture_v2(recvList[i], nullptr, &audioInput, nullptr, timeout);
+			if (type == NDIlib_frame_type_error) waited = false; // Returned at once, e.g. a lost connection
+			if (type != NDIlib_frame_type_audio) continue;
+			received = true;
+			NDIAudioFrameProcess(audioInput, *queueList[i], scratch, latencyFrames);
+			NDIlib_recv_free_audio_v2(recvList[i], &audioInput);
+		}
+		if (!received && !waited) std::this_thread::sleep_for(NDI_IDLE_BACKOFF);
+	}
+}
+
+/**
+ * @brief List the NDI sources found, let the user pick some of them and connect a receiver to each.
+ * Returns an empty list when no source is found.
+ */
+static std::vector<NDIlib_recv_instance_t> NDIReceiversCreate(NDIlib_find_instance_t pNDIFind)
+{
 	uint32_t NDISourceNum = 0;
 	const NDIlib_source_t* pSources = nullptr;
 	bool found = false;
@@ -35,7 +166,8 @@ void NDIAudioReceive(std::vector<audioQueue<float>> &queueList, int PA_SAMPLE_RA
 		pSources = NDIlib_find_get_current_sources(pNDIFind, &NDISourceNum);
 		found = true;
 	}
-	NDIErrorCheck(pSources);
+	if (NDISourceNum == 0) pSources = nullptr;
+	if (!NDIErrorCheck(pSources)) return {};
 	std::print("NDI sources list:\n");
 	for (std::size_t i = 0; i < NDISourceNum; i++)
 		std::print("Source {}\nName : {}\nIP   : {}\n\n", i, pSources[i].p_ndi_name, pSources[i].p_url_address);
@@ -75,48 +207,135 @@ void NDIAudioReceive(std::vector<audioQueue<float>> &queueList, int PA_SAMPLE_RA
 		if (!sourceMatched) std::print("Source do not exist! Please try again.\n");
 	} while (true);
 	std::vector<NDIlib_recv_instance_t> recvList;
-	
 	for (auto &i : sourceList)
+		if (const auto recv = NDIErrorCheck(NDIlib_recv_create_v3(&i)))
+			recvList.push_back(recv);
+	return recvList;
+}
+
+void NDIAudioReceive(sourceRegistry<mixQueue> &registry, int PA_SAMPLE_RATE, int PA_OUTPUT_CHANNELS, const NDIReceiveOptions &options)
+{
+	NDIlib_initialize();
+
+	const NDIlib_find_create_t NDIFindCreateDesc;
+	auto pNDIFind = NDIErrorCheck(NDIlib_find_create_v2(&NDIFindCreateDesc));
+	if (!pNDIFind)
 	{
-		auto pNDIRecv = NDIErrorCheck(NDIlib_recv_create_v3(&i));
-		recvList.push_back(pNDIRecv);
-		audioQueue<float> NDIdata(PA_SAMPLE_RATE, PA_OUTPUT_CHANNELS, 0);
-		queueList.push_back(std::move(NDIdata));
+		NDIlib_destroy();
+		return;
 	}
+	const auto recvList		 = NDIReceiversCreate(pNDIFind);
+	const auto latencyFrames = static_cast<std::size_t>(PA_SAMPLE_RATE) * NDI_TARGET_LATENCY / 1000;
 	
-	auto inputDelay = 0;
+	// Queues are owned by the registry, workers feed them through these pointers until they are removed.
+	std::vector<mixQueue*> queueList;
+	for (std::size_t i = 0; i < recvList.size(); i++)
+	{
+		// NDI senders run on their own clock, let the queue absorb the drift by resampling.
+		auto NDIdata = std::make_unique<mixQueue>(PA_SAMPLE_RATE, PA_OUTPUT_CHANNELS, 0);
+		NDIdata->setDriftControl(true);
+		NDIdata->setTargetLatency(latencyFrames);
+		queueList.push_back(registry.add(std::move(NDIdata)));
+	}
+	
+	const auto sourceNum = recvList.size();
+	const auto workerNum = options.workerCount == 0 ? sourceNum : std::min(options.workerCount, sourceNum);
+	const auto coreNum	 = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+	std::vector<std::jthread> workerList;
+	workerList.reserve(workerNum);
+	for (std::size_t w = 0; w < workerNum; w++)
+	{
+		std::vector<std::size_t> sources;
+		for (auto i = w; i < sourceNum; i += workerNum)
+			sources.push_back(i);
+		workerList.emplace_back(NDICaptureWorker, std::move(sources), std::cref(recvList), std::cref(queueList), latencyFrames);
+		if (options.pinWorkers) NDIWorkerPin(workerList.back(), (options.firstCore + w) % coreNum);
+	}
+	for (auto &i : workerList)
+		i.join();
+	for (auto i : queueList)
+		registry.remove(i);
 
-	while (true)
+	NDIlib_find_destroy(pNDIFind);
+	for (auto &i : recvList)
 	{
-		for (auto i = 0; i < recvList.size();i++)
-		{
-			inputDelay = queueList[i].getInputDelay() > inputDelay ? queueList[i].getInputDelay() : inputDelay;
-			NDIlib_audio_frame_v2_t audioInput;
-			auto type = NDIlib_recv_capture_v2(recvList[i], nullptr, &audioInput, nullptr,0);
-			if (type == NDIlib_frame_type_none) continue;
-			if (type == NDIlib_frame_type_audio)
-			{
-				const auto dataSize = static_cast<size_t>(audioInput.no_samples) * audioInput.no_channels;
+		NDIlib_recv_destroy(i);
+	}
+	NDIlib_destroy();
+}
 
-				// Create a NDI audio object and convert it to interleaved float format.
-				NDIlib_audio_frame_interleaved_32f_t audioDataNDI;
-				audioDataNDI.p_data = new float[dataSize];
-				NDIlib_util_audio_to_interleaved_32f_v2(&audioInput, &audioDataNDI);
+#pragma region FrameSync input
+/**
+ * @brief Receivers wrapped in FrameSync, published once complete so the output callback never sees a partial list.
+ */
+struct NDIFrameSyncSet
+{
+	std::vector<NDIlib_recv_instance_t>		 recvList;
+	std::vector<NDIlib_framesync_instance_t> syncList;
+	int										 sampleRate;
+	int										 channels;
+};
+static std::atomic<NDIFrameSyncSet*> frameSyncSet(nullptr);
 
-				queueList[i].setCapacity(dataSize * QUEUE_SIZE_MULTIPLIER);
-				queueList[i].push(audioDataNDI.p_data, audioDataNDI.no_samples, audioDataNDI.no_channels, audioDataNDI.sample_rate);
+void NDIFrameSyncReceive(int PA_SAMPLE_RATE, int PA_OUTPUT_CHANNELS)
+{
+	NDIlib_initialize();
 
-				delete[] audioDataNDI.p_data;
-			}
-			else continue;
-		}
-		std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(inputDelay)));
+	const NDIlib_find_create_t NDIFindCreateDesc;
+	auto pNDIFind = NDIErrorCheck(NDIlib_find_create_v2(&NDIFindCreateDesc));
+	if (!pNDIFind)
+	{
+		NDIlib_destroy();
+		return;
 	}
-
+	auto set	  = new NDIFrameSyncSet{ NDIReceiversCreate(pNDIFind), {}, PA_SAMPLE_RATE, PA_OUTPUT_CHANNELS };
+	// A receiver whose FrameSync cannot be created is dropped, the lists stay index aligned.
+	std::erase_if(set->recvList, [set](NDIlib_recv_instance_t i)
+	{
+		const auto sync = NDIErrorCheck(NDIlib_framesync_create(i));
+		if (sync)
+			set->syncList.push_back(sync);
+		else
+			NDIlib_recv_destroy(i);
+		return !sync;
+	});
 	NDIlib_find_destroy(pNDIFind);
-	for (auto &i : recvList)
+
+	frameSyncSet.store(set, std::memory_order_release);
+}
+
+std::size_t NDIFrameSyncSourceCount()
+{
+	const auto set = frameSyncSet.load(std::memory_order_acquire);
+	return set ? set->syncList.size() : 0;
+}
+
+std::size_t NDIFrameSyncMix(float* out, std::size_t frames)
+{
+	const auto set = frameSyncSet.load(std::memory_order_acquire);
+	if (!set) return 0;
+
+	for (auto &i : set->syncList)
 	{
-		NDIlib_recv_destroy(i);
+		// FrameSync resamples to the output clock and hands back exactly the frames asked for, silence before the first frame.
+		NDIlib_audio_frame_v2_t audioInput;
+		NDIlib_framesync_capture_audio(i, &audioInput, set->sampleRate, set->channels, static_cast<int>(frames));
+		if (audioInput.p_data && audioInput.no_channels == set->channels)
+			mixPlanar(out, audioInput.p_data, std::min<std::size_t>(frames, audioInput.no_samples), static_cast<std::uint8_t>(set->channels), audioInput.channel_stride_in_bytes / sizeof(float), 1.0f);
+		NDIlib_framesync_free_audio(i, &audioInput);
 	}
+	return set->syncList.size();
+}
+
+void NDIFrameSyncClose()
+{
+	const auto set = frameSyncSet.exchange(nullptr, std::memory_order_acq_rel);
+	if (!set) return;
+	for (auto &i : set->syncList)
+		NDIlib_framesync_destroy(i);
+	for (auto &i : set->recvList)
+		NDIlib_recv_destroy(i);
+	delete set;
 	NDIlib_destroy();
-}
\ No newline at end of file
+}
+#pragma endregion
@@ -2,10 +2,435 @@
 #include <string>
 #include <iostream>
 #include <filesystem>
+#include <chrono>
+#include <cstring>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace fs = std::filesystem;
 
-void sndfileReceive(std::vector<audioQueue<float>>&queueList, int PA_SAMPLE_RATE, int PA_OUTPUT_CHANNELS)
+constexpr auto SNDFILE_TARGET_LATENCY	= 200;									// Read ahead in ms
+constexpr auto SNDFILE_CHUNK_DIVIDER	= 4;									// Chunks per read ahead
+constexpr auto SNDFILE_IDLE_BACKOFF		= std::chrono::milliseconds(5);
+constexpr auto SNDFILE_POLL_INTERVAL	= std::chrono::milliseconds(100);
+constexpr auto SNDFILE_RENDER_READ_AHEAD= 2000;									// Offline read ahead in ms, large so a refill is rarely waited for
+constexpr auto SNDFILE_RENDER_BLOCK		= 512;									// Frames mixed per pull
+
+#pragma region File source
+fileSource::fileSource(sourceRegistry<mixQueue>& registry,
+					   std::uint32_t					  sampleRate,
+					   std::uint8_t						  channels,
+					   std::size_t						  readAheadFrames,
+					   const fileCue&					  cue)
+	:	cueIn			(cue.in),
+		cueOut			(cue.out),
+		looping			(cue.loop),
+		seekTarget		(noSeek),
+		cueMoved		(false),
+		registry		(registry),
+		queue			(nullptr),
+		outputRate		(sampleRate),
+		outputChannels	(channels),
+		chunkFrames		(std::max<std::size_t>(1, readAheadFrames / SNDFILE_CHUNK_DIVIDER)),
+		readAheadFrames	(readAheadFrames),
+		position		(0),
+		length			(0),
+		endOfFile		(false){}
+
+fileSource::~fileSource()
+{
+	stop();
+	if (queue) registry.remove(queue);
+}
+
+/**
+ * @brief Create the queue, prefill it with one read ahead, publish it and start the I/O thread.
+ */
+void fileSource::start(std::size_t lengthFrames, std::uint32_t fileRate)
+{
+	length	 = lengthFrames;
+	position = std::min(cueIn.load(), length);
+
+	// Room for the read ahead plus one resampled chunk, so a refill never has to be split.
+	const auto ratio = static_cast<double>(outputRate) / fileRate;
+	auto fileQueue = std::make_unique<mixQueue>(outputRate, outputChannels, static_cast<std::size_t>((readAheadFrames + chunkFrames) * std::max(1.0, ratio) * 2));
+
+	// Prefill before the queue becomes visible, the mixer never sees a source that is still buffering.
+	queue = fileQueue.get();
+	while (queue->size() / outputChannels < readAheadFrames && readChunk()) {}
+	registry.add(std::move(fileQueue));
+	reader = std::jthread([this](std::stop_token stop) { readLoop(stop); });
+}
+
+/**
+ * @brief Stop the I/O thread, the reader feeds the queue through pushFrames so this comes before anything else goes.
+ */
+void fileSource::stop()
+{
+	if (!reader.joinable()) return;
+	reader.request_stop();
+	reader.join();
+}
+
+/**
+ * @brief Move the cue points, a play cursor left outside of the new region jumps to the new cue in.
+ */
+void fileSource::setCue(std::size_t in, std::size_t out)
+{
+	cueIn	.store(in);
+	cueOut	.store(out);
+	cueMoved.store(true);
+}
+
+std::size_t fileSource::regionEnd() const
+{
+	const auto out = cueOut.load();
+	return out == 0 ? length : std::min(out, length);
+}
+
+/**
+ * @brief Read and push one chunk at the play cursor, wrapping to the cue in when looping.
+ * Returns false at the end, or when nothing could be pushed : the same frames are tried again on the next call.
+ */
+bool fileSource::readChunk()
+{
+	auto end = regionEnd();
+	if (position >= end)
+	{
+		const auto in = std::min(cueIn.load(), end);
+		if (!looping.load() || in == end)
+		{
+			endOfFile = true;
+			return false;
+		}
+		position = in; // Gapless : the next frames go right behind the last ones in the queue
+	}
+	if (endOfFile) endOfFile = false; // Looping was turned on or the cue out moved after the end was reached
+
+	const auto frames = std::min(chunkFrames, end - position);
+	const auto pushed = pushFrames(position, frames);
+	position += pushed;
+	return pushed != 0;
+}
+
+/**
+ * @brief Prepare the new region while the queued audio keeps playing, then drop the queue and continue from frame.
+ */
+void fileSource::seekTo(std::size_t frame)
+{
+	const auto end	 = regionEnd();
+	const auto first = std::min(frame, end);
+	prefetch(first, std::min(readAheadFrames, end - first));
+	queue->flush();
+	position  = first;
+	endOfFile = false;
+}
+
+/**
+ * @brief I/O thread body, it lives as long as the source so requests made after the end of the file are still served.
+ */
+void fileSource::readLoop(std::stop_token stop)
+{
+	while (!stop.stop_requested())
+	{
+		if (const auto target = seekTarget.exchange(noSeek); target != noSeek)
+			seekTo(target);
+		else if (cueMoved.exchange(false) && (position < cueIn.load() || position >= regionEnd()))
+			seekTo(cueIn.load());
+
+		// Refill only below the read ahead, otherwise, or once at the end, wait for the mixer to drain a part of it.
+		if (queue->size() / outputChannels >= readAheadFrames || !readChunk())
+			std::this_thread::sleep_for(SNDFILE_IDLE_BACKOFF);
+	}
+}
+#pragma endregion
+
+#pragma region Sndfile source
+sndfileSource::sndfileSource(const fs::path&					path,
+							 sourceRegistry<mixQueue>& registry,
+							 std::uint32_t						sampleRate,
+							 std::uint8_t						channels,
+							 std::size_t						readAheadFrames,
+							 const fileCue&						cue)
+	:	fileSource		(registry, sampleRate, channels, readAheadFrames, cue),
+		file			(path.string()),
+		filePosition	(0),
+		stagedFirst		(0),
+		stagedFrames	(0)
+{
+	if (!file || file.error() || file.channels() <= 0 || file.samplerate() <= 0)
+	{
+		std::print(stderr, "Sndfile error : cannot open {}.\n", path.string());
+		endOfFile = true;
+		return;
+	}
+	chunk.resize(chunkFrames * file.channels());
+	start(static_cast<std::size_t>(file.frames()), static_cast<std::uint32_t>(file.samplerate()));
+}
+
+std::size_t sndfileSource::pushFrames(std::size_t first, std::size_t frames)
+{
+	sf_count_t read = 0;
+	if (stagedFrames != 0 && first == stagedFirst && frames <= stagedFrames)
+	{
+		// The chunk read ahead of a seek, already in memory.
+		read = static_cast<sf_count_t>(frames);
+		if (frames < stagedFrames) filePosition = file.seek(static_cast<sf_count_t>(first + frames), SEEK_SET);
+	}
+	else
+	{
+		if (static_cast<sf_count_t>(first) != filePosition)
+			filePosition = file.seek(static_cast<sf_count_t>(first), SEEK_SET);
+		read = file.readf(chunk.data(), static_cast<sf_count_t>(frames));
+		if (read < static_cast<sf_count_t>(frames)) length = first + static_cast<std::size_t>(std::max<sf_count_t>(0, read)); // The file is shorter than announced, its real end is here
+		if (read <= 0) return 0;
+		filePosition += read;
+	}
+	if (!queue->push(chunk.data(), static_cast<std::size_t>(read), static_cast<std::uint8_t>(file.channels()), static_cast<std::uint32_t>(file.samplerate())))
+	{
+		// Rejected : keep the chunk staged, the next call at the same position pushes it again without touching the disk.
+		stagedFirst	 = first;
+		stagedFrames = static_cast<std::size_t>(read);
+		return 0;
+	}
+	stagedFrames = 0;
+	return static_cast<std::size_t>(read);
+}
+
+/**
+ * @brief Decode the first chunk of a seek target, so the switch does not wait for the disk.
+ */
+void sndfileSource::prefetch(std::size_t first, std::size_t frames)
+{
+	filePosition = file.seek(static_cast<sf_count_t>(first), SEEK_SET);
+	const auto read = filePosition < 0 ? 0 : file.readf(chunk.data(), static_cast<sf_count_t>(std::min(frames, chunkFrames)));
+	filePosition	= filePosition < 0 ? -1 : filePosition + read;
+	stagedFirst		= first;
+	stagedFrames	= static_cast<std::size_t>(std::max<sf_count_t>(0, read));
+}
+#pragma endregion
+
+#pragma region Memory mapped WAV source
+#ifdef _WIN32
+mappedFile::mappedFile(const fs::path& path)
+	:	fileHandle		(nullptr),
+		mappingHandle	(nullptr),
+		view			(nullptr),
+		viewSize		(0)
+{
+	const auto handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) return;
+	fileHandle = handle;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) return;
+	mappingHandle = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mappingHandle) return;
+	view	 = static_cast<const std::byte*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	viewSize = view ? static_cast<std::size_t>(fileSize.QuadPart) : 0;
+}
+
+mappedFile::~mappedFile()
+{
+	if (view)		   UnmapViewOfFile(view);
+	if (mappingHandle) CloseHandle(mappingHandle);
+	if (fileHandle)	   CloseHandle(fileHandle);
+}
+
+void mappedFile::prefetch(std::size_t offset, std::size_t bytes) const
+{
+	if (offset >= viewSize) return;
+	WIN32_MEMORY_RANGE_ENTRY range{ const_cast<std::byte*>(view + offset), std::min(bytes, viewSize - offset) };
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+#else
+mappedFile::mappedFile(const fs::path& path)
+	:	descriptor		(open(path.c_str(), O_RDONLY)),
+		view			(nullptr),
+		viewSize		(0)
+{
+	struct stat fileStat;
+	if (descriptor < 0 || fstat(descriptor, &fileStat) != 0 || fileStat.st_size == 0) return;
+	const auto mapping = mmap(nullptr, static_cast<std::size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+	if (mapping == MAP_FAILED) return;
+	view	 = static_cast<const std::byte*>(mapping);
+	viewSize = static_cast<std::size_t>(fileStat.st_size);
+	madvise(mapping, viewSize, MADV_SEQUENTIAL);
+}
+
+mappedFile::~mappedFile()
+{
+	if (view)			 munmap(const_cast<std::byte*>(view), viewSize);
+	if (descriptor >= 0) close(descriptor);
+}
+
+void mappedFile::prefetch(std::size_t offset, std::size_t bytes) const
+{
+	if (offset >= viewSize) return;
+	// madvise wants a page aligned start.
+	const auto page	 = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	const auto start = offset / page * page;
+	madvise(const_cast<std::byte*>(view + start), std::min(bytes + offset - start, viewSize - start), MADV_WILLNEED);
+}
+#endif
+
+/**
+ * @brief Little endian unsigned integer of 2 or 4 bytes.
+ */
+static std::uint32_t readLittleEndian(const std::byte* data, std::size_t bytes)
+{
+	std::uint32_t value = 0;
+	for (std::size_t i = 0; i < bytes; i++)
+		value |= static_cast<std::uint32_t>(data[i]) << (8 * i);
+	return value;
+}
+
+mappedWavSource::mappedWavSource(const fs::path&					path,
+								 sourceRegistry<mixQueue>& registry,
+								 std::uint32_t						sampleRate,
+								 std::uint8_t						channels,
+								 std::size_t						readAheadFrames,
+								 const fileCue&						cue)
+	:	fileSource		(registry, sampleRate, channels, readAheadFrames, cue),
+		file			(path),
+		samples			(nullptr),
+		fileChannels	(0),
+		fileRate		(0),
+		isFloat			(false)
+{
+	if (!file.data() || !parseHeader() || (!isFloat && reinterpret_cast<std::uintptr_t>(samples) % alignof(std::int16_t) != 0))
+	{
+		// Not an error : the caller falls back to libsndfile for anything this reader does not handle.
+		endOfFile = true;
+		return;
+	}
+	// Only samples the queue cannot take from the mapping as they are go through chunk : misaligned float, 16 bit PCM into a non 16 bit queue.
+	const bool direct = isFloat ? reinterpret_cast<std::uintptr_t>(samples) % alignof(float) == 0 : std::same_as<mixSample, std::int16_t>;
+	if (!direct)
+		chunk.resize(chunkFrames * fileChannels);
+	file.prefetch(static_cast<std::size_t>(samples - file.data()), readAheadFrames * fileChannels * (isFloat ? 4 : 2));
+	start(length, fileRate);
+}
+
+/**
+ * @brief Walk the RIFF chunks, accept 16 bit PCM and 32 bit float (plain or extensible) and locate the samples.
+ */
+bool mappedWavSource::parseHeader()
+{
+	const auto* data = file.data();
+	const auto	size = file.size();
+	if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0) return false;
+
+	std::uint32_t format = 0, bits = 0, blockAlign = 0;
+	for (std::size_t offset = 12; offset + 8 <= size; )
+	{
+		const auto* chunkData = data + offset + 8;
+		const auto	chunkSize = static_cast<std::size_t>(readLittleEndian(data + offset + 4, 4));
+		const auto	available = std::min(chunkSize, size - offset - 8);
+		if (std::memcmp(data + offset, "fmt ", 4) == 0 && available >= 16)
+		{
+			format		 = readLittleEndian(chunkData, 2);
+			fileChannels = static_cast<std::uint8_t>(readLittleEndian(chunkData + 2, 2));
+			fileRate	 = readLittleEndian(chunkData + 4, 4);
+			blockAlign	 = readLittleEndian(chunkData + 12, 2);
+			bits		 = readLittleEndian(chunkData + 14, 2);
+			if (format == 0xFFFE && available >= 26) format = readLittleEndian(chunkData + 24, 2); // Extensible : sub format
+		}
+		else if (std::memcmp(data + offset, "data", 4) == 0)
+		{
+			isFloat = format == 3 && bits == 32;
+			if (!(isFloat || (format == 1 && bits == 16)) || fileChannels == 0 || fileRate == 0 || blockAlign != fileChannels * bits / 8) 
+				return false;
+			samples = chunkData;
+			length	= available / blockAlign;
+			return true;
+		}
+		offset += 8 + chunkSize + (chunkSize & 1);
+	}
+	return false;
+}
+
+/**
+ * @brief Push 16 bit PCM : as it is into a 16 bit queue, widened to float once in chunk for any other queue.
+ */
+template<typename T>
+static bool pcm16Push(audioQueue<T>& queue, const std::int16_t* data, std::size_t frames, std::uint8_t channels, std::uint32_t rate, std::vector<float>& chunk)
+{
+	if constexpr (std::same_as<T, std::int16_t>)
+		return queue.push(data, frames, channels, rate);
+	else
+	{
+		samplesToFloat(data, chunk.data(), frames * channels);
+		return queue.push(chunk.data(), frames, channels, rate);
+	}
+}
+
+std::size_t mappedWavSource::pushFrames(std::size_t first, std::size_t frames)
+{
+	const auto frameBytes = static_cast<std::size_t>(fileChannels) * (isFloat ? 4 : 2);
+	const auto* source	  = samples + first * frameBytes;
+
+	// Keep one read ahead after this chunk resident, so the pages are in memory before the cursor reaches them.
+	file.prefetch(static_cast<std::size_t>(source - file.data()) + frames * frameBytes, readAheadFrames * frameBytes);
+
+	// A rejected chunk returns 0 and is read again on the next call.
+	if (!isFloat)
+		return pcm16Push(*queue, reinterpret_cast<const std::int16_t*>(source), frames, fileChannels, fileRate, chunk) ? frames : 0;
+	if (chunk.empty())
+	{
+		// Aligned float : the queue copies straight out of the mapping.
+		return queue->push(reinterpret_cast<const float*>(source), frames, fileChannels, fileRate) ? frames : 0;
+	}
+	std::memcpy(chunk.data(), source, frames * frameBytes);
+	return queue->push(chunk.data(), frames, fileChannels, fileRate) ? frames : 0;
+}
+
+/**
+ * @brief Ask for one read ahead at a seek target and fault in its first chunk, so the switch does not wait for the disk.
+ */
+void mappedWavSource::prefetch(std::size_t first, std::size_t frames)
+{
+	const auto frameBytes = static_cast<std::size_t>(fileChannels) * (isFloat ? 4 : 2);
+	const auto offset	  = static_cast<std::size_t>(samples - file.data()) + first * frameBytes;
+	file.prefetch(offset, frames * frameBytes);
+
+	constexpr std::size_t pageSize = 4096;
+	const auto			  touched  = std::min(frames, chunkFrames) * frameBytes;
+	for (std::size_t i = 0; i < touched; i += pageSize)
+		static_cast<void>(*static_cast<const volatile std::byte*>(file.data() + offset + i));
+}
+#pragma endregion
+
+/**
+ * @brief Open path as a streamed source of registry.
+ *
+ * Uncompressed WAV plays from a memory mapping, everything else and unsupported WAV variants go through libsndfile.
+ */
+static std::unique_ptr<fileSource> fileSourceOpen(const fs::path&					   path,
+												  sourceRegistry<mixQueue>&   registry,
+												  int								   PA_SAMPLE_RATE,
+												  int								   PA_OUTPUT_CHANNELS,
+												  std::size_t						   readAheadFrames)
+{
+	std::unique_ptr<fileSource> source;
+	if (path.extension() == ".wav" || path.extension() == ".WAV")
+		source = std::make_unique<mappedWavSource>(path, registry, PA_SAMPLE_RATE, static_cast<std::uint8_t>(PA_OUTPUT_CHANNELS), readAheadFrames);
+	if (!source || !source->isOpen())
+		source = std::make_unique<sndfileSource>(path, registry, PA_SAMPLE_RATE, static_cast<std::uint8_t>(PA_OUTPUT_CHANNELS), readAheadFrames);
+	return source;
+}
+
+/**
+ * @brief Ask for sound file paths on the console until end is entered.
+ */
+static std::vector<fs::path> sndfilePathsPrompt()
 {
 	std::vector<fs::path> pathList;
 	std::print("Sndfile: Please enter the path of the sound file, enter end to confirm.");
@@ -21,7 +446,7 @@ void sndfileReceive(std::vector<audioQueue<float>>&queueList, int PA_SAMPLE_RATE
 		else
 		{
 			fs::path filePath(filePathStr);
-			if (fs::exists(filePath))
+			if (!fs::exists(filePath))
 			{
 				std::print("File do not exist! Please try again.\n");
 				continue;
@@ -35,25 +460,79 @@ void sndfileReceive(std::vector<audioQueue<float>>&queueList, int PA_SAMPLE_RATE
 		}
 		 
 	} while (true);
+	return pathList;
+}
 
-	std::vector<SndfileHandle> fileHandleList;
+void sndfileReceive(sourceRegistry<mixQueue>& registry, int PA_SAMPLE_RATE, int PA_OUTPUT_CHANNELS, std::vector<fs::path> pathList)
+{
+	if (pathList.empty())
+		pathList = sndfilePathsPrompt();
+
+	const auto readAheadFrames = static_cast<std::size_t>(PA_SAMPLE_RATE) * SNDFILE_TARGET_LATENCY / 1000;
+	std::vector<std::unique_ptr<fileSource>> sourceList;
 	for (auto &i : pathList)
+		sourceList.push_back(fileSourceOpen(i, registry, PA_SAMPLE_RATE, PA_OUTPUT_CHANNELS, readAheadFrames));
+
+	// A source leaves the mix once its file is read and played out.
+	while (!sourceList.empty())
 	{
-		SndfileHandle sndFile(i.string());
-		fileHandleList.push_back(std::move(sndFile));
+		std::erase_if(sourceList, [](const std::unique_ptr<fileSource>& i) { return i->finished(); });
+		std::this_thread::sleep_for(SNDFILE_POLL_INTERVAL);
 	}
+	return;
+}
 
-	for (auto &i : fileHandleList)
+std::size_t sndfileRender(const std::vector<fs::path>& inputs,
+						  const fs::path&			   output,
+						  int						   PA_SAMPLE_RATE,
+						  int						   PA_OUTPUT_CHANNELS,
+						  std::size_t				   maxFrames)
+{
+	const auto format = output.extension() == ".flac" || output.extension() == ".FLAC" ? SF_FORMAT_FLAC | SF_FORMAT_PCM_24 : SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+	SndfileHandle outputFile(output.string(), SFM_WRITE, format, PA_OUTPUT_CHANNELS, PA_SAMPLE_RATE);
+	if (outputFile.error())
 	{
-		const size_t bufferSize = i.frames() * i.channels() + 100;
-		float* temp = new float[bufferSize];
-		i.read(temp, bufferSize);
+		std::print(stderr, "Sndfile: cannot create {} : {}.\n", output.string(), outputFile.strError());
+		return 0;
+	}
+	outputFile.command(SFC_SET_CLIPPING, nullptr, SF_TRUE);
 
-		audioQueue<float> sndQueue(PA_SAMPLE_RATE, PA_OUTPUT_CHANNELS, bufferSize);
-		sndQueue.push(temp, i.frames(),i.channels(), i.samplerate());
-		delete[] temp;
+	const auto readAheadFrames = static_cast<std::size_t>(PA_SAMPLE_RATE) * SNDFILE_RENDER_READ_AHEAD / 1000;
+	sourceRegistry<mixQueue>		 registry;
+	std::vector<std::unique_ptr<fileSource>> sourceList;
+	for (auto &i : inputs)
+	{
+		auto source = fileSourceOpen(i, registry, PA_SAMPLE_RATE, PA_OUTPUT_CHANNELS, readAheadFrames);
+		if (source->isOpen())
+			sourceList.push_back(std::move(source));
+		else
+			std::print(stderr, "Sndfile: cannot open {}, skipped.\n", i.string());
+	}
+
+	const auto startTime = std::chrono::steady_clock::now();
+	std::vector<float> block(static_cast<std::size_t>(SNDFILE_RENDER_BLOCK) * PA_OUTPUT_CHANNELS);
+	std::size_t rendered = 0;
+	while (maxFrames == 0 || rendered < maxFrames)
+	{
+		const auto frames = maxFrames == 0 ? SNDFILE_RENDER_BLOCK : std::min<std::size_t>(SNDFILE_RENDER_BLOCK, maxFrames - rendered);
+
+		// The pull loop stands in for the device clock : a block is only mixed once every input can fill it.
+		while (!std::ranges::all_of(sourceList, [frames](const std::unique_ptr<fileSource>& i) { return i->ready(frames); }))
+			std::this_thread::yield();
 
-		queueList.push_back(std::move(sndQueue));		
+		std::fill(block.begin(), block.end(), 0.0f);
+		std::size_t mixed = 0;
+		registry.forEach([&](mixQueue& i) { mixed = std::max(mixed, i.mixInto(block.data(), frames)); });
+		if (mixed == 0 && std::ranges::all_of(sourceList, [](const std::unique_ptr<fileSource>& i) { return i->finished(); })) break;
+
+		// Only the tail of the last input gives a short block, an input ending while others play is padded with silence.
+		const auto written = mixed == 0 ? frames : mixed;
+		outputFile.writef(block.data(), static_cast<sf_count_t>(written));
+		rendered += written;
 	}
-	return;
+
+	const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	const auto audio   = static_cast<double>(rendered) / PA_SAMPLE_RATE;
+	std::print("Sndfile: rendered {:.2f} s of audio into {} in {:.3f} s ({:.1f}x real time).\n", audio, output.filename().string(), seconds, seconds > 0 ? audio / seconds : 0.0);
+	return rendered;
 }
@@ -0,0 +1,632 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <format>
+#include <numbers>
+#include <optional>
+#include <random>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "audioQueue.h"
+#include "outputBackend.h"
+#include "sourceRegistry.h"
+#include "Processing.NDI.Lib.h"
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#pragma region Global constants
+constexpr auto BENCH_SAMPLE_RATE			= 48000;
+constexpr auto BENCH_CHANNELS				= 2;
+constexpr auto BENCH_BUFFER_SIZE			= 512;
+constexpr auto BENCH_ITERATIONS				= 2000;
+constexpr std::size_t BENCH_SOURCE_COUNTS[]	= { 1, 2, 4, 8, 16, 32, 64 };
+constexpr auto NDI_BENCH_SECONDS			= 10;
+constexpr auto NDI_BENCH_FRAME_SIZE			= 480;						// 10 ms frames from the local sender
+constexpr auto NDI_BENCH_PULSE_PERIOD		= BENCH_SAMPLE_RATE / 2;	// One impulse every 500 ms
+constexpr auto NDI_BENCH_TARGET_LATENCY		= BENCH_SAMPLE_RATE / 50;	// 20 ms, as the queue based NDI input
+constexpr auto NDI_BENCH_SENDER_NAME		= "audioBenchmark source";
+constexpr std::size_t  QUEUE_BENCH_BLOCK_SIZES[]	= { 64, 256, 1024, 4096, 8192 };
+constexpr std::uint8_t QUEUE_BENCH_CHANNELS[]		= { 1, 2, 8 };
+constexpr auto QUEUE_BENCH_FRAMES			= std::size_t(1) << 20;		// Frames moved through the queue per case
+constexpr auto QUEUE_BENCH_INPUT_RATE		= 44100;					// Producer rate of the resampled cases
+constexpr auto QUEUE_BENCH_PRODUCER_CORE	= 0;
+constexpr auto QUEUE_BENCH_CONSUMER_CORE	= 1;
+constexpr std::size_t LOAD_BENCH_SOURCE_COUNTS[]	= { 1, 4, 16, 32, 64, 128, 256 };
+constexpr std::uint32_t LOAD_BENCH_RATES[]		= { 48000, 44100, 96000, 32000 };
+constexpr std::uint8_t  LOAD_BENCH_LAYOUTS[]	= { 2, 1, 6 };
+constexpr auto LOAD_BENCH_SECONDS			= 5;						// Default run length, enough for p50 and p99
+constexpr auto LOAD_BENCH_LONG_CALLBACKS	= 12000;					// load long : about 12 callbacks above p99.9, 128 s per run
+constexpr auto LOAD_BENCH_PRODUCER_PERIOD	= 10;						// ms of audio per producer push
+constexpr auto LOAD_BENCH_TARGET_LATENCY	= BENCH_SAMPLE_RATE / 50;	// 20 ms, as the queue based NDI input
+#pragma endregion
+
+using benchClock = std::chrono::steady_clock;
+
+/**
+ * @brief One buffer of interleaved sine wave, different for every source so the mix is not trivially constant.
+ */
+static std::vector<float> sineBlock(std::size_t sourceIndex)
+{
+	std::vector<float> block(BENCH_BUFFER_SIZE * BENCH_CHANNELS);
+	const auto frequency = 220.0 + 10.0 * sourceIndex;
+	for (std::size_t i = 0; i < BENCH_BUFFER_SIZE; i++)
+	{
+		const auto value = static_cast<float>(0.1 * std::sin(2 * std::numbers::pi * frequency * i / BENCH_SAMPLE_RATE));
+		for (std::size_t c = 0; c < BENCH_CHANNELS; c++)
+			block[i * BENCH_CHANNELS + c] = value;
+	}
+	return block;
+}
+
+#pragma region Mix benchmark
+/**
+ * @brief Time the output side mix : every source is accumulated into one buffer with mixInto.
+ *
+ * Producers refill the queues outside of the timed region, so only the mix pass is measured.
+ * Returns the average time of one output buffer in nanoseconds.
+ */
+static double mixBenchmark(std::size_t sourceNum, float gain)
+{
+	std::vector<audioQueue<float>>  queueList;
+	std::vector<std::vector<float>> blockList;
+	queueList.reserve(sourceNum);
+	for (std::size_t i = 0; i < sourceNum; i++)
+	{
+		queueList.emplace_back(BENCH_SAMPLE_RATE, BENCH_CHANNELS, BENCH_BUFFER_SIZE * 4);
+		blockList.push_back(sineBlock(i));
+	}
+
+	std::vector<float> out(BENCH_BUFFER_SIZE * BENCH_CHANNELS);
+	benchClock::duration total{};
+	float checksum = 0;
+	for (auto iteration = 0; iteration < BENCH_ITERATIONS; iteration++)
+	{
+		for (std::size_t i = 0; i < sourceNum; i++)
+		{
+			auto region = queueList[i].reserveWrite(BENCH_BUFFER_SIZE);
+			std::copy(blockList[i].begin(), blockList[i].begin() + region.first.size(), region.first.begin());
+			std::copy(blockList[i].begin() + region.first.size(), blockList[i].end(), region.second.begin());
+			queueList[i].commitWrite(BENCH_BUFFER_SIZE);
+		}
+
+		const auto start = benchClock::now();
+		std::fill(out.begin(), out.end(), 0.0f);
+		for (auto &i : queueList)
+			i.mixInto(out.data(), BENCH_BUFFER_SIZE, gain);
+		total += benchClock::now() - start;
+		checksum += out[iteration % out.size()];
+	}
+	// Keeps the mix from being optimized away.
+	if (checksum == 12345.0f) std::print("");
+
+	return std::chrono::duration<double, std::nano>(total).count() / BENCH_ITERATIONS;
+}
+#pragma endregion
+
+#pragma region Queue benchmark
+/**
+ * @brief Hardware cache miss counter of the whole process, including threads started after start. Linux only.
+ *
+ * Stays unavailable where perf events are not supported or not permitted, the benchmark then reports n/a.
+ */
+class cacheMissCounter
+{
+	private :
+		int descriptor = -1;
+	public :
+		cacheMissCounter()
+		{
+#ifdef __linux__
+			perf_event_attr attr{};
+			attr.type			= PERF_TYPE_HARDWARE;
+			attr.size			= sizeof(attr);
+			attr.config			= PERF_COUNT_HW_CACHE_MISSES;
+			attr.disabled		= 1;
+			attr.inherit		= 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv		= 1;
+			descriptor = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+		}
+		cacheMissCounter(const cacheMissCounter& other) = delete;
+		~cacheMissCounter()
+		{
+#ifdef __linux__
+			if (descriptor >= 0) close(descriptor);
+#endif
+		}
+
+		void start()
+		{
+#ifdef __linux__
+			if (descriptor < 0) return;
+			ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+			ioctl(descriptor, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+		}
+		std::optional<std::uint64_t> stop()
+		{
+#ifdef __linux__
+			if (descriptor < 0) return std::nullopt;
+			ioctl(descriptor, PERF_EVENT_IOC_DISABLE, 0);
+			std::uint64_t count = 0;
+			if (read(descriptor, &count, sizeof(count)) == sizeof(count)) return count;
+#endif
+			return std::nullopt;
+		}
+};
+
+/**
+ * @brief Pin the calling thread to one core, does nothing on platforms without an affinity API.
+ */
+static void benchPin(std::size_t core)
+{
+	core %= std::max(1u, std::thread::hardware_concurrency());
+#ifdef _WIN32
+	SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << (core % (sizeof(DWORD_PTR) * 8)));
+#elif defined(__linux__)
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	CPU_SET(core % CPU_SETSIZE, &cpuSet);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#endif
+}
+
+struct queueBenchResult
+{
+	double						 nsPerFrame;
+	std::optional<std::uint64_t> cacheMisses;
+};
+
+/**
+ * @brief Move QUEUE_BENCH_FRAMES frames through one queue in blocks of blockFrames, pushed then popped.
+ *
+ * Single threaded, each block is pushed then everything queued is popped right away on the same core, a resampled
+ * block is longer than blockFrames so popping only that much would fill the queue. Threaded, a producer and
+ * a consumer pinned to two cores spin on the queue, so the cost of sharing its indices is included.
+ * The time is per input frame, cache misses are for the whole case.
+ */
+template<audioType T>
+static queueBenchResult queueBenchmark(std::size_t blockFrames, std::uint8_t channels, bool resampled, bool threaded)
+{
+	const std::uint32_t inputRate = resampled ? QUEUE_BENCH_INPUT_RATE : BENCH_SAMPLE_RATE;
+	const auto			samples	  = blockFrames * channels;
+	audioQueue<T> queue(BENCH_SAMPLE_RATE, channels, blockFrames * 8);
+	std::vector<T> block(samples);
+	std::vector<T> out(samples * 2 + 64 * channels);	// A resampled block and the converter's spare frames
+	for (std::size_t i = 0; i < samples; i++)
+		block[i] = sampleCast<T>(0.1 * std::sin(0.01 * i) * sampleTraits<T>::scale);
+
+	const auto blocks = QUEUE_BENCH_FRAMES / blockFrames;
+	cacheMissCounter counter;
+	counter.start();
+	const auto start = benchClock::now();
+	if (!threaded)
+	{
+		for (std::size_t i = 0; i < blocks; i++)
+		{
+			queue.push(block.data(), blockFrames, channels, inputRate);
+			auto ptr = out.data();
+			queue.pop(ptr, queue.size() / channels, false);
+		}
+	}
+	else
+	{
+		// Room for a resampled block on top of the one being written, so push never has to report a full queue.
+		const auto room = samples * 2 + 64 * channels;
+		std::atomic<bool> produced(false);
+		std::jthread producer([&]
+		{
+			benchPin(QUEUE_BENCH_PRODUCER_CORE);
+			for (std::size_t i = 0; i < blocks; i++)
+			{
+				while (queue.capacity() - queue.size() < room) std::this_thread::yield();
+				queue.push(block.data(), blockFrames, channels, inputRate);
+			}
+			produced.store(true, std::memory_order_release);
+		});
+		benchPin(QUEUE_BENCH_CONSUMER_CORE);
+		while (true)
+		{
+			const bool last = produced.load(std::memory_order_acquire);
+			const auto frames = std::min(blockFrames, queue.size() / channels);
+			if (frames == 0 && last) break;
+			if (frames < blockFrames && !last)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			auto ptr = out.data();
+			queue.pop(ptr, frames, false);
+		}
+	}
+	const auto elapsed = benchClock::now() - start;
+	return { std::chrono::duration<double, std::nano>(elapsed).count() / (blocks * blockFrames), counter.stop() };
+}
+
+/**
+ * @brief Every queue benchmark case, one table row each.
+ */
+template<audioType T>
+static void queueBenchmarkSuite(std::string_view typeName)
+{
+	for (const bool threaded : { false, true })
+		for (const bool resampled : { false, true })
+			for (const auto channels : QUEUE_BENCH_CHANNELS)
+				for (const auto blockFrames : QUEUE_BENCH_BLOCK_SIZES)
+				{
+					const auto result = queueBenchmark<T>(blockFrames, channels, resampled, threaded);
+					const auto misses = result.cacheMisses ? std::format("{:.2f}", static_cast<double>(*result.cacheMisses) * 1000 / QUEUE_BENCH_FRAMES) : std::string("n/a");
+					std::print("{:>6} {:>8} {:>9} {:>8} {:>7} {:>10.2f} {:>16}\n", typeName, threaded ? "spsc" : "single", resampled ? "yes" : "no", channels, blockFrames, result.nsPerFrame, misses);
+				}
+}
+#pragma endregion
+
+#pragma region Load benchmark
+/**
+ * @brief Output side of the load benchmark : the sources mixed by the callback and the time of every callback.
+ */
+struct loadBenchState
+{
+	sourceRegistry<mixQueue>	registry;
+	std::vector<std::uint32_t>	callbackNs;
+	std::atomic<std::size_t>	callbackCount{ 0 };
+};
+
+/**
+ * @brief Same mix as the audioMixer output callback, timed from entry to return.
+ */
+static void loadBenchRender(float* out, std::size_t frames, PaStreamCallbackFlags, void* userData)
+{
+	auto&	   state = *static_cast<loadBenchState*>(userData);
+	const auto start = benchClock::now();
+	std::fill_n(out, frames * BENCH_CHANNELS, 0.0f);
+	state.registry.forEach([out, frames](mixQueue& i) { i.mixInto(out, frames); });
+
+	const auto count = state.callbackCount.load(std::memory_order_relaxed);
+	if (count < state.callbackNs.size())
+	{
+		state.callbackNs[count] = static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(benchClock::now() - start).count());
+		state.callbackCount.store(count + 1, std::memory_order_release);
+	}
+}
+
+/**
+ * @brief Synthetic source clocked like a network sender : one block of sine or noise every LOAD_BENCH_PRODUCER_PERIOD ms.
+ */
+static void loadBenchProducer(std::stop_token stop, mixQueue* queue, std::size_t sourceIndex)
+{
+	const auto sampleRate = LOAD_BENCH_RATES[sourceIndex % std::size(LOAD_BENCH_RATES)];
+	const auto channels	  = LOAD_BENCH_LAYOUTS[sourceIndex % std::size(LOAD_BENCH_LAYOUTS)];
+	const auto frames	  = static_cast<std::size_t>(sampleRate) * LOAD_BENCH_PRODUCER_PERIOD / 1000;
+	const bool noise	  = sourceIndex % 2 == 1;
+	const auto step		  = 2 * std::numbers::pi * (220.0 + 10.0 * sourceIndex) / sampleRate;
+
+	std::minstd_rand					  generator(static_cast<std::uint32_t>(sourceIndex) + 1);
+	std::uniform_real_distribution<float> distribution(-0.05f, 0.05f);
+	std::vector<float> block(frames * channels);
+	double			   phase	= 0;
+	auto			   deadline = benchClock::now();
+	while (!stop.stop_requested())
+	{
+		for (std::size_t i = 0; i < frames; i++, phase += step)
+		{
+			const auto value = noise ? distribution(generator) : static_cast<float>(0.05 * std::sin(phase));
+			std::fill_n(block.begin() + i * channels, channels, value);
+		}
+		queue->push(block.data(), frames, channels, sampleRate);
+		deadline += std::chrono::milliseconds(LOAD_BENCH_PRODUCER_PERIOD);
+		std::this_thread::sleep_until(deadline);
+	}
+}
+
+struct loadBenchResult
+{
+	double		  p50Us;
+	double		  p99Us;
+	double		  p999Us;
+	double		  maxUs;
+	std::size_t	  overBudget;		// Callbacks longer than one buffer period
+	std::uint64_t missedDeadlines;	// Periods the simulated device clock had to drop
+	std::uint64_t underruns;
+};
+
+/**
+ * @brief Mix sourceNum synthetic sources for callbacks output buffers on the null backend clock.
+ *
+ * Every source has its own producer thread, sample rate and channel layout, drift compensation and a
+ * latency target, as the NDI input queues. Callback times are collected in a preallocated table and
+ * sorted afterwards, so measuring adds no work to the callback beyond two clock reads.
+ */
+static loadBenchResult loadBenchmark(std::size_t sourceNum, std::size_t callbacks)
+{
+	loadBenchState state;
+	state.callbackNs.resize(callbacks * 2); // Room for a late stop, the table is never grown while the callback runs
+	std::vector<std::jthread> producers;
+	for (std::size_t i = 0; i < sourceNum; i++)
+	{
+		const auto frames = static_cast<std::size_t>(LOAD_BENCH_RATES[i % std::size(LOAD_BENCH_RATES)]) * LOAD_BENCH_PRODUCER_PERIOD / 1000;
+		auto queue = std::make_unique<mixQueue>(BENCH_SAMPLE_RATE, BENCH_CHANNELS, 4 * (frames * 2 + LOAD_BENCH_TARGET_LATENCY));
+		queue->setDriftControl(true);
+		queue->setTargetLatency(LOAD_BENCH_TARGET_LATENCY);
+		producers.emplace_back(loadBenchProducer, state.registry.add(std::move(queue)), i);
+	}
+
+	const outputSettings settings{ BENCH_SAMPLE_RATE, BENCH_CHANNELS, BENCH_BUFFER_SIZE, {} };
+	auto device = outputBackendCreate(outputBackendType::null, settings, loadBenchRender, &state);
+	device->start();
+	std::this_thread::sleep_for(std::chrono::milliseconds(callbacks * 1000ull * BENCH_BUFFER_SIZE / BENCH_SAMPLE_RATE));
+	device->stop();
+	// Stop every producer before joining any, one by one the last ones would keep filling queues nobody drains.
+	for (auto& i : producers)
+		i.request_stop();
+	producers.clear();
+
+	const auto count = state.callbackCount.load(std::memory_order_acquire);
+	std::vector<std::uint32_t> times(state.callbackNs.begin(), state.callbackNs.begin() + count);
+	std::ranges::sort(times);
+	const auto percentile = [&times](double p) { return times.empty() ? 0.0 : times[std::min(times.size() - 1, static_cast<std::size_t>(p * times.size()))] / 1000.0; };
+	const auto budgetNs	  = 1000000000ull * BENCH_BUFFER_SIZE / BENCH_SAMPLE_RATE;
+
+	loadBenchResult result;
+	result.p50Us		   = percentile(0.5);
+	result.p99Us		   = percentile(0.99);
+	result.p999Us		   = percentile(0.999);
+	result.maxUs		   = times.empty() ? 0.0 : times.back() / 1000.0;
+	result.overBudget	   = static_cast<std::size_t>(std::ranges::count_if(times, [budgetNs](std::uint32_t i) { return i > budgetNs; }));
+	result.missedDeadlines = device->missedDeadlines();
+	result.underruns	   = 0;
+	state.registry.forEach([&result](const mixQueue& i) { result.underruns += i.getUnderrunCount(); });
+	return result;
+}
+#pragma endregion
+
+#pragma region NDI input benchmark
+struct NDIBenchResult
+{
+	double		pullNs;			// Output side cost per buffer
+	double		receiveNs;		// Receive side cost per NDI frame, 0 when the SDK does it internally
+	double		meanLatencyMs;
+	double		maxLatencyMs;
+	std::size_t pulses;
+};
+
+/**
+ * @brief Impulse times shared between the local sender and the pulling side, written once per impulse.
+ */
+struct NDIPulseLog
+{
+	std::vector<benchClock::time_point> sent = std::vector<benchClock::time_point>(NDI_BENCH_SECONDS * 4);
+	std::atomic<std::size_t>			sentCount{ 0 };
+	std::size_t							matched	  = 0;	// Impulses up to this one are already measured
+	std::size_t							seenCount = 0;
+	benchClock::duration				latencySum{};
+	benchClock::duration				latencyMax{};
+};
+
+/**
+ * @brief Local NDI sender clocked by the SDK : silent stereo with one impulse every NDI_BENCH_PULSE_PERIOD samples.
+ */
+static void NDIBenchSender(std::stop_token stop, NDIlib_send_instance_t sender, NDIPulseLog &log)
+{
+	std::vector<float> planes(NDI_BENCH_FRAME_SIZE * BENCH_CHANNELS);
+	NDIlib_audio_frame_v2_t frame(BENCH_SAMPLE_RATE, BENCH_CHANNELS, NDI_BENCH_FRAME_SIZE);
+	frame.p_data				  = planes.data();
+	frame.channel_stride_in_bytes = NDI_BENCH_FRAME_SIZE * sizeof(float);
+
+	for (std::size_t position = 0; !stop.stop_requested(); position += NDI_BENCH_FRAME_SIZE)
+	{
+		std::fill(planes.begin(), planes.end(), 0.0f);
+		const auto pulseOffset = (NDI_BENCH_PULSE_PERIOD - position % NDI_BENCH_PULSE_PERIOD) % NDI_BENCH_PULSE_PERIOD;
+		const bool pulse	   = pulseOffset < NDI_BENCH_FRAME_SIZE && log.sentCount.load() < log.sent.size();
+		if (pulse)
+			for (std::size_t c = 0; c < BENCH_CHANNELS; c++)
+				planes[c * NDI_BENCH_FRAME_SIZE + pulseOffset] = 1.0f;
+
+		// clock_audio paces this call to real time, the impulse leaves once the frame is handed over.
+		NDIlib_send_send_audio_v2(sender, &frame);
+		if (pulse)
+		{
+			const auto count = log.sentCount.load(std::memory_order_relaxed);
+			log.sent[count]  = benchClock::now() + std::chrono::microseconds(pulseOffset * 1000000ll / BENCH_SAMPLE_RATE);
+			log.sentCount.store(count + 1, std::memory_order_release);
+		}
+	}
+}
+
+/**
+ * @brief Look for impulses in one pulled buffer, the latency is taken at the frame the impulse lands on.
+ * 
+ * A detection is matched to the last impulse sent before it, impulses lost while connecting are skipped
+ * and the ringing of a resampled impulse is not counted twice.
+ */
+static void NDIPulseDetect(const std::vector<float> &out, benchClock::time_point pulledAt, NDIPulseLog &log)
+{
+	for (std::size_t i = 0; i < BENCH_BUFFER_SIZE; i++)
+	{
+		if (out[i * BENCH_CHANNELS] < 0.3f) continue;
+		const auto at	 = pulledAt + std::chrono::microseconds(i * 1000000ll / BENCH_SAMPLE_RATE);
+		auto	   count = log.sentCount.load(std::memory_order_acquire);
+		while (count > 0 && log.sent[count - 1] > at) count--;
+		if (count <= log.matched) continue;
+
+		log.matched		= count;
+		const auto latency = at - log.sent[count - 1];
+		log.latencySum += latency;
+		log.latencyMax  = std::max(log.latencyMax, latency);
+		log.seenCount++;
+	}
+}
+
+/**
+ * @brief Pull one source at the output rate for NDI_BENCH_SECONDS, either through an audioQueue fed by a
+ * capture thread as NDIAudioReceive does, or straight from FrameSync as NDIFrameSyncMix does.
+ */
+static NDIBenchResult NDIBenchmark(const NDIlib_source_t &source, NDIlib_send_instance_t sender, bool frameSync)
+{
+	NDIlib_recv_create_v3_t recvDesc;
+	recvDesc.source_to_connect_to = source;
+	recvDesc.bandwidth			  = NDIlib_recv_bandwidth_audio_only;
+	auto receiver = NDIlib_recv_create_v3(&recvDesc);
+	auto sync	  = frameSync ? NDIlib_framesync_create(receiver) : nullptr;
+
+	NDIPulseLog log;
+	audioQueue<float> queue(BENCH_SAMPLE_RATE, BENCH_CHANNELS, 4 * (NDI_BENCH_FRAME_SIZE + NDI_BENCH_TARGET_LATENCY));
+	queue.setDriftControl(true);
+	queue.setTargetLatency(NDI_BENCH_TARGET_LATENCY);
+
+	benchClock::duration receiveTotal{};
+	std::size_t			 receiveCount = 0;
+	std::jthread capture;
+	if (!frameSync)
+		capture = std::jthread([&](std::stop_token stop)
+		{
+			std::vector<float> scratch;
+			while (!stop.stop_requested())
+			{
+				NDIlib_audio_frame_v2_t audioInput;
+				if (NDIlib_recv_capture_v2(receiver, nullptr, &audioInput, nullptr, 100) != NDIlib_frame_type_audio) continue;
+				const auto start = benchClock::now();
+				scratch.resize(static_cast<std::size_t>(audioInput.no_samples) * audioInput.no_channels);
+				NDIlib_audio_frame_interleaved_32f_t interleaved;
+				interleaved.p_data = scratch.data();
+				NDIlib_util_audio_to_interleaved_32f_v2(&audioInput, &interleaved);
+				queue.push(interleaved.p_data, interleaved.no_samples, interleaved.no_channels, interleaved.sample_rate);
+				receiveTotal += benchClock::now() - start;
+				receiveCount++;
+				NDIlib_recv_free_audio_v2(receiver, &audioInput);
+			}
+		});
+
+	std::vector<float> out(BENCH_BUFFER_SIZE * BENCH_CHANNELS);
+	const auto period	= std::chrono::nanoseconds(1000000000ll * BENCH_BUFFER_SIZE / BENCH_SAMPLE_RATE);
+	const auto buffers	= NDI_BENCH_SECONDS * BENCH_SAMPLE_RATE / BENCH_BUFFER_SIZE;
+	auto	   deadline = benchClock::now();
+	benchClock::duration pullTotal{};
+
+	std::jthread producer(NDIBenchSender, sender, std::ref(log));
+	for (auto buffer = 0; buffer < buffers; buffer++)
+	{
+		deadline += period;
+		std::this_thread::sleep_until(deadline);
+
+		const auto start = benchClock::now();
+		std::fill(out.begin(), out.end(), 0.0f);
+		if (frameSync)
+		{
+			NDIlib_audio_frame_v2_t audioInput;
+			NDIlib_framesync_capture_audio(sync, &audioInput, BENCH_SAMPLE_RATE, BENCH_CHANNELS, BENCH_BUFFER_SIZE);
+			if (audioInput.p_data)
+				mixPlanar(out.data(), audioInput.p_data, BENCH_BUFFER_SIZE, BENCH_CHANNELS, audioInput.channel_stride_in_bytes / sizeof(float), 1.0f);
+			NDIlib_framesync_free_audio(sync, &audioInput);
+		}
+		else
+			queue.mixInto(out.data(), BENCH_BUFFER_SIZE);
+		pullTotal += benchClock::now() - start;
+		NDIPulseDetect(out, start, log);
+	}
+	producer.request_stop();
+	producer.join();
+	capture.request_stop();
+	if (capture.joinable()) capture.join();
+	if (sync) NDIlib_framesync_destroy(sync);
+	NDIlib_recv_destroy(receiver);
+
+	NDIBenchResult result;
+	result.pullNs		 = std::chrono::duration<double, std::nano>(pullTotal).count() / buffers;
+	result.receiveNs	 = receiveCount == 0 ? 0.0 : std::chrono::duration<double, std::nano>(receiveTotal).count() / receiveCount;
+	result.meanLatencyMs = log.seenCount == 0 ? 0.0 : std::chrono::duration<double, std::milli>(log.latencySum).count() / log.seenCount;
+	result.maxLatencyMs	 = std::chrono::duration<double, std::milli>(log.latencyMax).count();
+	result.pulses		 = log.seenCount;
+	return result;
+}
+#pragma endregion
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && std::string_view(argv[1]) == "queue")
+	{
+		// audioQueue hot path alone : push then pop, no mixing.
+		std::print("Queue benchmark : {} frames per case, resampled cases from {} Hz.\n", QUEUE_BENCH_FRAMES, QUEUE_BENCH_INPUT_RATE);
+		std::print("{:>6} {:>8} {:>9} {:>8} {:>7} {:>10} {:>16}\n", "type", "threads", "resample", "channels", "block", "ns / frame", "misses / kframe");
+		queueBenchmarkSuite<float>("float");
+		queueBenchmarkSuite<short>("short");
+		queueBenchmarkSuite<int24>("int24");
+		queueBenchmarkSuite<std::int32_t>("int32");
+		queueBenchmarkSuite<double>("double");
+		return 0;
+	}
+	if (argc > 1 && std::string_view(argv[1]) == "load")
+	{
+		// Whole pipeline without a sound card : producer threads, queues and the output mix on a simulated device clock.
+		// load [seconds | long] : the default run is short, long collects enough callbacks for a meaningful p99.9.
+		auto callbacks = static_cast<std::size_t>(LOAD_BENCH_SECONDS) * BENCH_SAMPLE_RATE / BENCH_BUFFER_SIZE;
+		if (argc > 2 && std::string_view(argv[2]) == "long")
+			callbacks = LOAD_BENCH_LONG_CALLBACKS;
+		else if (argc > 2)
+			callbacks = static_cast<std::size_t>(std::max(1, std::atoi(argv[2]))) * BENCH_SAMPLE_RATE / BENCH_BUFFER_SIZE;
+		std::print("Load benchmark : {} callbacks ({:.0f} s) per run, {} frame buffers ({:.2f} ms budget).\n", callbacks, static_cast<double>(callbacks) * BENCH_BUFFER_SIZE / BENCH_SAMPLE_RATE, BENCH_BUFFER_SIZE, 1000.0 * BENCH_BUFFER_SIZE / BENCH_SAMPLE_RATE);
+		if (callbacks < 10000)
+			std::print("p99.9 is within a few callbacks of the max below 10000 callbacks, run load long for it.\n");
+		std::print("{:>8} {:>10} {:>10} {:>10} {:>10} {:>12} {:>8} {:>10}\n", "sources", "p50 us", "p99 us", "p99.9 us", "max us", "over budget", "missed", "underruns");
+		for (const auto sourceNum : LOAD_BENCH_SOURCE_COUNTS)
+		{
+			const auto result = loadBenchmark(sourceNum, callbacks);
+			std::print("{:>8} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>12} {:>8} {:>10}\n", sourceNum, result.p50Us, result.p99Us, result.p999Us, result.maxUs, result.overBudget, result.missedDeadlines, result.underruns);
+		}
+		return 0;
+	}
+
+	std::print("Mix benchmark : {} frames x {} channels per buffer, {} buffers per run.\n", BENCH_BUFFER_SIZE, BENCH_CHANNELS, BENCH_ITERATIONS);
+	std::print("{:>8} {:>16} {:>14}\n", "sources", "ns / buffer", "samples / ns");
+	for (const auto sourceNum : BENCH_SOURCE_COUNTS)
+	{
+		const auto nsPerBuffer = mixBenchmark(sourceNum, 0.5f);
+		const auto samples	   = static_cast<double>(sourceNum) * BENCH_BUFFER_SIZE * BENCH_CHANNELS;
+		std::print("{:>8} {:>16.1f} {:>14.3f}\n", sourceNum, nsPerBuffer, samples / nsPerBuffer);
+	}
+	if (argc < 2 || std::string_view(argv[1]) != "ndi") return 0;
+
+	// Queue versus FrameSync input, fed by a local NDI sender so it needs the NDI runtime but no network source.
+	if (!NDIlib_initialize()) return 1;
+	NDIlib_send_create_t sendDesc(NDI_BENCH_SENDER_NAME, nullptr, false, true);
+	auto sender	  = NDIlib_send_create(&sendDesc);
+	auto finder	  = NDIlib_find_create_v2();
+
+	// Other senders on the network are ignored, only the local one carries the impulses.
+	const std::string_view senderName = NDIlib_send_get_source_name(sender)->p_ndi_name;
+	std::print("Waiting for {} on the network.\n", senderName);
+	const NDIlib_source_t* local = nullptr;
+	while (!local)
+	{
+		NDIlib_find_wait_for_sources(finder, 1000);
+		uint32_t sourceNum = 0;
+		const auto sources = NDIlib_find_get_current_sources(finder, &sourceNum);
+		const auto found   = std::find_if(sources, sources + sourceNum, [senderName](const NDIlib_source_t& i) { return senderName == i.p_ndi_name; });
+		if (found != sources + sourceNum) local = found;
+	}
+	const NDIlib_source_t source(local->p_ndi_name, local->p_url_address);
+
+	std::print("\nNDI input benchmark : {} s per mode, {} frames per output buffer.\n", NDI_BENCH_SECONDS, BENCH_BUFFER_SIZE);
+	std::print("{:>10} {:>14} {:>16} {:>16} {:>15} {:>7}\n", "mode", "pull ns/buf", "receive ns/frame", "mean latency ms", "max latency ms", "pulses");
+	for (const bool frameSync : { false, true })
+	{
+		const auto result = NDIBenchmark(source, sender, frameSync);
+		std::print("{:>10} {:>14.1f} {:>16.1f} {:>16.2f} {:>15.2f} {:>7}\n", frameSync ? "framesync" : "queue", result.pullNs, result.receiveNs, result.meanLatencyMs, result.maxLatencyMs, result.pulses);
+	}
+	NDIlib_send_destroy(sender);
+	NDIlib_find_destroy(finder);
+	NDIlib_destroy();
+	return 0;
+}
@@ -1,8 +1,13 @@
-﻿#include <csignal>
+﻿#include <chrono>
+#include <csignal>
+#include <fstream>
 #include <iostream>
+#include <optional>
+#include <thread>
 #include "NDIModule.h" 
-#include "portaudio.h"
 #include "audioQueue.h"
+#include "callbackMonitor.h"
+#include "outputBackend.h"
 #include "SoundFileModule.h"
 
 #pragma region System signal handler
@@ -18,89 +23,201 @@ static void sigIntHandler(int) {exit_loop = true;}
 #pragma region Global constants and variables
 constexpr auto PA_SAMPLE_RATE				= 48000;
 constexpr auto PA_BUFFER_SIZE				= 512;
-constexpr auto PA_INPUT_CHANNELS			= 0;
 constexpr auto PA_OUTPUT_CHANNELS			= 2;
-constexpr auto PA_FORMAT					= paFloat32;
-std::vector<audioQueue<float>> NDIdata;
-std::vector<audioQueue<float>> SNDdata;
+constexpr auto OUTPUT_MONITOR_INTERVAL		= std::chrono::milliseconds(100);
+constexpr auto METRICS_DUMP_INTERVAL		= 10;						// Monitor intervals between two metrics dumps
+constexpr auto METRICS_JSON_PATH			= "audioMixer.metrics.json";
+constexpr auto METRICS_PROMETHEUS_PATH		= "audioMixer.prom";		// For a node exporter textfile collector
+sourceRegistry<mixQueue> NDIdata;
+sourceRegistry<mixQueue> SNDdata;
+callbackMonitor outputMonitor(PA_SAMPLE_RATE);
 #pragma endregion
 
-/**
- * @brief Error checker PortAudio library.
- * 
- * Exit with failure in case of error.
- */
-inline void  PAErrorCheck (PaError err){if ( err){ std::print("PortAudio error : {}.\n", Pa_GetErrorText(err)); exit(EXIT_FAILURE);}}
-
 #pragma region NDI Inout
-void NDIAudioTread()
+void NDIAudioTread(NDIInputMode mode)
 {
-	NDIAudioReceive(NDIdata, PA_SAMPLE_RATE, PA_OUTPUT_CHANNELS);
+	if (mode == NDIInputMode::frameSync)
+		NDIFrameSyncReceive(PA_SAMPLE_RATE, PA_OUTPUT_CHANNELS);
+	else
+		NDIAudioReceive(NDIdata, PA_SAMPLE_RATE, PA_OUTPUT_CHANNELS);
 }
 #pragma endregion
 
 #pragma region Sndfile Input
-void sndfileRead()
+void sndfileRead(std::vector<std::filesystem::path> pathList)
 {
-	//sndfileReceive(SNDdata,PA_SAMPLE_RATE, PA_OUTPUT_CHANNELS);
+	// The paths come from the command line, the console belongs to the NDI source selection.
+	sndfileReceive(SNDdata, PA_SAMPLE_RATE, PA_OUTPUT_CHANNELS, std::move(pathList));
 }
 #pragma endregion
 
-#pragma region PA output
-static int portAudioOutputCallback(	const	void*						inputBuffer,
-											void*						outputBuffer,
-											unsigned long				framesPerBuffer,
-									const	PaStreamCallbackTimeInfo*	timeInfo,
-											PaStreamCallbackFlags		statusFlags,
-											void*						UserData)
+#pragma region Output
+static void outputRender(float* out, std::size_t framesPerBuffer, PaStreamCallbackFlags statusFlags, void*)
+{
+	// Real time thread : no sleep, no I/O, no allocation. Missing samples stay silent and are counted by each queue.
+	const auto start = outputMonitor.begin();
+	std::fill_n(out, framesPerBuffer * PA_OUTPUT_CHANNELS, 0.0f);
+	NDIdata.forEach([out, framesPerBuffer](mixQueue& i) { i.mixInto(out, framesPerBuffer); });
+	SNDdata.forEach([out, framesPerBuffer](mixQueue& i) { i.mixInto(out, framesPerBuffer); });
+	NDIFrameSyncMix(out, framesPerBuffer);
+	outputMonitor.end(start, framesPerBuffer, statusFlags);
+}
+
+/**
+ * @brief Replace path with text, through a temporary file so a reader never sees half a dump.
+ */
+static void metricsWrite(const std::filesystem::path& path, const std::string& text)
 {
-	auto out = static_cast<float*>(outputBuffer);
-	memset(out, 0, sizeof(out) * framesPerBuffer);
-	auto outputDelay = 0;
-	for (auto& i : NDIdata)
+	auto temporary = path;
+	temporary += ".tmp";
 	{
-		outputDelay = i.getoutputDelay() > outputDelay ? i.getoutputDelay() : outputDelay;
-		if (!i.empty()) i.pop(out, framesPerBuffer, true);
+		std::ofstream file(temporary, std::ios::trunc);
+		file << text;
+		if (!file) return;
 	}
-	std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(outputDelay)));
-	
-	return paContinue;
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+}
+
+/**
+ * @brief Sum of the underruns of every input queue.
+ */
+std::uint64_t totalUnderruns()
+{
+	std::uint64_t total = 0;
+	NDIdata.forEach([&total](const mixQueue& i) { total += i.getUnderrunCount(); });
+	SNDdata.forEach([&total](const mixQueue& i) { total += i.getUnderrunCount(); });
+	return total;
 }
 
-void portAudioOutputThread()
+void audioOutputThread(outputBackendType type, std::filesystem::path filePath)
 {
 	std::signal(SIGINT, sigIntHandler);
 
-	PaStream* streamOut;
-	PAErrorCheck(Pa_OpenDefaultStream( &streamOut,				// PortAudio Stream
-										PA_INPUT_CHANNELS,				
-										PA_OUTPUT_CHANNELS,				
-										PA_FORMAT,						
-										PA_SAMPLE_RATE,					
-										PA_BUFFER_SIZE,					
-										portAudioOutputCallback,// Callback function called
-										nullptr));				// No user data passed
+	const outputSettings settings{ PA_SAMPLE_RATE, PA_OUTPUT_CHANNELS, PA_BUFFER_SIZE, std::move(filePath) };
+	const auto output = outputBackendCreate(type, settings, outputRender, nullptr);
+	if (!output) exit(EXIT_FAILURE);
 
+	bool streamActive = false;
+	std::uint64_t reportedMisses = 0;
+	std::uint64_t reportedOverruns = 0;
+	std::size_t   monitorTicks = 0;
+	std::uint64_t reportedUnderruns = 0;
+	std::uint64_t removedUnderruns = 0;
+	std::uint64_t reportedAllocations = 0;
 	while (!exit_loop)
 	{
-		if (NDIdata.empty()) Pa_StopStream(streamOut);
-		if (!NDIdata.empty()) Pa_StartStream(streamOut);
+		const bool hasInput = NDIdata.size() != 0 || SNDdata.size() != 0 || NDIFrameSyncSourceCount() != 0;
+		if (hasInput != streamActive)
+		{
+			if (hasInput)
+				streamActive = output->start();
+			else
+			{
+				output->stop();
+				streamActive = false;
+			}
+		}
+
+		// Underruns are counted by the callback and only reported from here.
+		// A finished sound file leaves the registry with its underruns, keep the total counting up.
+		auto underruns = totalUnderruns() + removedUnderruns;
+		if (underruns < reportedUnderruns)
+		{
+			removedUnderruns += reportedUnderruns - underruns;
+			underruns		  = reportedUnderruns;
+		}
+		if (underruns != reportedUnderruns)
+		{
+			std::print(stderr, "Output underruns : {} (+{}).\n", underruns, underruns - reportedUnderruns);
+			reportedUnderruns = underruns;
+		}
+		outputMonitor.setQueueUnderruns(underruns);
+		// Receive buffers only grow while new frame sizes show up, a steady stream keeps this silent.
+		const auto allocations = NDIAllocationCount();
+		if (allocations != reportedAllocations)
+		{
+			std::print(stderr, "NDI receive allocations : {} (+{}).\n", allocations, allocations - reportedAllocations);
+			reportedAllocations = allocations;
+		}
+		// Only the timer driven backends can tell when a buffer came too late.
+		const auto misses = output->missedDeadlines();
+		if (misses != reportedMisses)
+		{
+			std::print(stderr, "Output missed deadlines : {} (+{}).\n", misses, misses - reportedMisses);
+			reportedMisses = misses;
+		}
+		// The callback only records its own timing, reading it back never touches the real time path.
+		const auto overruns = outputMonitor.getOverrunCount();
+		if (overruns != reportedOverruns)
+		{
+			std::print(stderr, "Output callback overruns : {} (+{}), max {:.2f} ms.\n", overruns, overruns - reportedOverruns, outputMonitor.histogram().max() / 1e6);
+			reportedOverruns = overruns;
+		}
+		if (++monitorTicks % METRICS_DUMP_INTERVAL == 0)
+		{
+			metricsWrite(METRICS_JSON_PATH, outputMonitor.toJson());
+			metricsWrite(METRICS_PROMETHEUS_PATH, outputMonitor.toPrometheus());
+		}
+		std::this_thread::sleep_for(OUTPUT_MONITOR_INTERVAL);
 	}
 
-	PAErrorCheck(Pa_StopStream(streamOut));
-	PAErrorCheck(Pa_CloseStream(streamOut));
+	output->stop();
+	NDIFrameSyncClose();
 }
 #pragma endregion
-int main()
+int main(int argc, char* argv[])
 {
-	PAErrorCheck(Pa_Initialize());
-	std::thread ndiThread(NDIAudioTread);
-	//::thread sndfile(sndfileRead);
-	std::thread portaudio(portAudioOutputThread);
-
-	ndiThread.detach();
-	//sndfile.detach();
-	portaudio.join();
-	PAErrorCheck(Pa_Terminate());
+	// audioMixer render <output> <input> ... : offline mix of sound files, no audio device involved.
+	if (argc > 3 && std::string_view(argv[1]) == "render")
+	{
+		const std::vector<std::filesystem::path> inputs(argv + 3, argv + argc);
+		return sndfileRender(inputs, argv[2], PA_SAMPLE_RATE, PA_OUTPUT_CHANNELS) != 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Options, anywhere on the line :
+	// --framesync		 pull NDI audio through FrameSync from the output callback instead of queueing it.
+	// --ndi / --no-ndi	 force NDI input on or off. It is off by default for a headless backend given sound files,
+	//					 so a machine without sound card and NDI source never waits on the source prompt.
+	std::vector<std::string_view> args(argv + 1, argv + argc);
+	auto ndiMode = NDIInputMode::queue;
+	std::optional<bool> ndiWanted;
+	std::erase_if(args, [&ndiMode, &ndiWanted](std::string_view i)
+	{
+		if		(i == "--framesync") ndiMode   = NDIInputMode::frameSync;
+		else if (i == "--ndi")		 ndiWanted = true;
+		else if (i == "--no-ndi")	 ndiWanted = false;
+		else return false;
+		return true;
+	});
+
+	// audioMixer null | file <output> : play through a timer instead of the sound card, for machines without one.
+	auto backend = outputBackendType::portAudio;
+	std::filesystem::path outputPath;
+	std::size_t firstFile = 0;
+	if (args.size() > 0 && args[0] == "null")
+	{
+		backend	  = outputBackendType::null;
+		firstFile = 1;
+	}
+	else if (args.size() > 1 && args[0] == "file")
+	{
+		backend	   = outputBackendType::file;
+		outputPath = args[1];
+		firstFile  = 2;
+	}
+	// Any further argument is a sound file, streamed and mixed with the NDI sources.
+	std::vector<std::filesystem::path> soundFiles(args.begin() + std::min(firstFile, args.size()), args.end());
+
+	const bool headless = backend != outputBackendType::portAudio;
+	const bool ndiInput = ndiWanted.value_or(!headless || soundFiles.empty() || ndiMode == NDIInputMode::frameSync);
+
+	std::thread output(audioOutputThread, backend, outputPath);
+	if (ndiInput)
+		std::thread(NDIAudioTread, ndiMode).detach();
+	if (!soundFiles.empty())
+		std::thread(sndfileRead, std::move(soundFiles)).detach();
+
+	output.join();
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "outputBackend.h"
+#include <chrono>
+#include <print>
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+#pragma region PortAudio backend
+/**
+ * @brief Error checker PortAudio library, returns false and reports the error in case of error.
+ */
+static bool PAErrorCheck(PaError err)
+{
+	if (err == paNoError) return true;
+	std::print(stderr, "PortAudio error : {}.\n", Pa_GetErrorText(err));
+	return false;
+}
+
+portAudioBackend::portAudioBackend(const outputSettings& settings, renderFunction render, void* userData)
+	:	outputBackend	(settings, render, userData),
+		stream			(nullptr),
+		initialized		(PAErrorCheck(Pa_Initialize()))
+{
+	if (!initialized) return;
+	if (!PAErrorCheck(Pa_OpenDefaultStream(&stream,
+										   0,						// No input
+										   settings.channels,
+										   paFloat32,
+										   settings.sampleRate,
+										   settings.bufferFrames,
+										   callback,
+										   this)))
+		stream = nullptr;
+}
+
+portAudioBackend::~portAudioBackend()
+{
+	if (stream)
+	{
+		stop();
+		PAErrorCheck(Pa_CloseStream(stream));
+	}
+	if (initialized) PAErrorCheck(Pa_Terminate());
+}
+
+int portAudioBackend::callback(const	void*						/*inputBuffer*/,
+										void*						outputBuffer,
+										unsigned long				framesPerBuffer,
+								const	PaStreamCallbackTimeInfo*	/*timeInfo*/,
+										PaStreamCallbackFlags		statusFlags,
+										void*						self)
+{
+	const auto backend = static_cast<portAudioBackend*>(self);
+	backend->render(static_cast<float*>(outputBuffer), framesPerBuffer, statusFlags, backend->userData);
+	return paContinue;
+}
+
+bool portAudioBackend::start()
+{
+	if (!stream) return false;
+	return Pa_IsStreamActive(stream) == 1 || PAErrorCheck(Pa_StartStream(stream));
+}
+
+void portAudioBackend::stop()
+{
+	if (stream && Pa_IsStreamActive(stream) == 1) PAErrorCheck(Pa_StopStream(stream));
+}
+#pragma endregion
+
+#pragma region Null backend
+/**
+ * @brief Sleep until deadline on the monotonic clock, absolute so a late wake up is not carried over to the next period.
+ */
+static void sleepUntil(std::chrono::steady_clock::time_point deadline)
+{
+#ifdef _WIN32
+	std::this_thread::sleep_until(deadline);
+#else
+	// steady_clock is CLOCK_MONOTONIC on Linux, its time points convert directly.
+	const auto since = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+	const timespec wake{ static_cast<time_t>(since / 1'000'000'000), static_cast<long>(since % 1'000'000'000) };
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr) != 0) {} // Restart when interrupted by a signal
+#endif
+}
+
+nullBackend::nullBackend(const outputSettings& settings, renderFunction render, void* userData)
+	:	outputBackend	(settings, render, userData),
+		buffer			(settings.bufferFrames * settings.channels),
+		missed			(0){}
+
+bool nullBackend::start()
+{
+	if (!clock.joinable()) clock = std::jthread([this](std::stop_token stop) { clockLoop(stop); });
+	return true;
+}
+
+void nullBackend::stop()
+{
+	if (!clock.joinable()) return;
+	clock.request_stop();
+	clock.join();
+}
+
+void nullBackend::clockLoop(std::stop_token stop)
+{
+	// Deadlines are computed from the frame count since origin, so rounding never accumulates.
+	auto origin = std::chrono::steady_clock::now();
+	std::uint64_t frames = 0;
+	PaStreamCallbackFlags statusFlags = 0;
+	while (!stop.stop_requested())
+	{
+		render(buffer.data(), settings.bufferFrames, statusFlags, userData);
+		deliver(buffer.data(), settings.bufferFrames);
+		frames += settings.bufferFrames;
+
+		const auto elapsed	= std::chrono::duration<double>(static_cast<double>(frames) / settings.sampleRate);
+		const auto deadline = origin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(elapsed);
+		const auto now		= std::chrono::steady_clock::now();
+		if (now > deadline)
+		{
+			// Too late for this period, drop it like a device would and restart the schedule from now.
+			missed.fetch_add(1, std::memory_order_relaxed);
+			origin		= now;
+			frames		= 0;
+			statusFlags = paOutputUnderflow;
+			continue;
+		}
+		statusFlags = 0;
+		sleepUntil(deadline);
+	}
+}
+#pragma endregion
+
+#pragma region File backend
+fileBackend::fileBackend(const outputSettings& settings, renderFunction render, void* userData)
+	:	nullBackend		(settings, render, userData),
+		file			(settings.filePath.string(), SFM_WRITE,
+						 settings.filePath.extension() == ".flac" || settings.filePath.extension() == ".FLAC" ? SF_FORMAT_FLAC | SF_FORMAT_PCM_24 : SF_FORMAT_WAV | SF_FORMAT_FLOAT,
+						 settings.channels, static_cast<int>(settings.sampleRate))
+{
+	if (file.error())
+		std::print(stderr, "Output file {} : {}.\n", settings.filePath.string(), file.strError());
+	else
+		file.command(SFC_SET_CLIPPING, nullptr, SF_TRUE);
+}
+
+void fileBackend::deliver(const float* buffer, std::size_t frames)
+{
+	file.writef(buffer, static_cast<sf_count_t>(frames));
+}
+#pragma endregion
+
+/**
+ * @brief Open the backend of type, returns nullptr if its device or file cannot be opened.
+ */
+std::unique_ptr<outputBackend> outputBackendCreate(outputBackendType type, const outputSettings& settings, outputBackend::renderFunction render, void* userData)
+{
+	std::unique_ptr<outputBackend> backend;
+	switch (type)
+	{
+	case outputBackendType::portAudio	: backend = std::make_unique<portAudioBackend>(settings, render, userData); break;
+	case outputBackendType::null		: backend = std::make_unique<nullBackend>	  (settings, render, userData); break;
+	case outputBackendType::file		: backend = std::make_unique<fileBackend>	  (settings, render, userData); break;
+	}
+	if (!backend || !backend->isOpen()) return nullptr;
+	return backend;
+}
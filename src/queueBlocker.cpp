@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "queueBlocker.h"
 
 queueBlocker::queueBlocker()
@@ -8,12 +9,14 @@ queueBlocker::queueBlocker()
 		integral(0),
 		derivative(0),
 		target(50),
-		delay(0){}
+		delay(0),
+		limit(0.005){}
 
 queueBlocker::queueBlocker(	double kp,
 							double ki, 
 							double kd, 
-							double targetPoint)
+							double targetPoint,
+							double outputLimit)
 	:	Kp(kp), 
 		Ki(ki), 
 		Kd(kd), 
@@ -21,14 +24,30 @@ queueBlocker::queueBlocker(	double kp,
 		integral(0), 
 		derivative(0),
 		target(targetPoint),
-		delay(0){}
+		delay(0),
+		limit(outputLimit){}
 
 double queueBlocker::delayCalculate(double value)
 {
 	auto err	=	target - value;
-	integral	+=	value;
+	integral	+=	err;
 	derivative	=	err - prevErr;
 	auto delay	=	Kp * err + Ki * integral + Kd * derivative;
 	prevErr		=	err;
 	return delay;
-}
\ No newline at end of file
+}
+
+double queueBlocker::ratioCalculate(double value)
+{
+	auto err	=	target - value;
+	derivative	=	err - prevErr;
+	prevErr		=	err;
+
+	// Anti windup : only integrate while the output is not pinned at the limit in the same direction.
+	auto output	=	Kp * err + Ki * (integral + err) + Kd * derivative;
+	if ((output <  limit || err < 0) && (output > -limit || err > 0))
+		integral +=	err;
+
+	output		=	Kp * err + Ki * integral + Kd * derivative;
+	return 1.0 + std::clamp(output, -limit, limit);
+}